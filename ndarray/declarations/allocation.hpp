@@ -0,0 +1,150 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Allocation policy of the NDArray storage: parallel first touch, huge pages and NUMA binding.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "ndarray/declarations/parallel.hpp"
+#include "ndarray/declarations/stats.hpp"
+
+namespace nd {
+
+struct AllocationPolicy {
+  // Initialize new arrays with the threads and partitioning used to evaluate them, so that on a
+  // NUMA system each page is placed on the node of the thread that later accesses it.
+  bool parallel_first_touch = true;
+  // Request transparent huge pages for buffers of at least this many bytes.
+  std::size_t huge_page_threshold = std::size_t(1) << 22;
+  // If non negative, bind the pages of large buffers to this NUMA node.
+  int numa_node = -1;
+};
+
+namespace details {
+
+// Size of a huge page, and alignment of the buffers which can use them.
+constexpr std::size_t huge_page_size = std::size_t(1) << 21;
+
+inline AllocationPolicy& allocationPolicy() {
+  static AllocationPolicy policy;
+  return policy;
+}
+
+}  // namespace details
+
+// The policy applies to the arrays allocated afterwards. Must not be called concurrently with an
+// allocation.
+inline void setAllocationPolicy(const AllocationPolicy& policy) {
+  details::allocationPolicy() = policy;
+}
+
+inline const AllocationPolicy& getAllocationPolicy() {
+  return details::allocationPolicy();
+}
+
+namespace details {
+
+// Allocator of the NDArray storage. Large buffers are aligned to huge pages, advised and bound
+// according to the allocation policy. Elements constructed without arguments are default
+// initialized, which leaves the pages of trivial types untouched until their first parallel
+// write. Allocations are counted in the statistics of 'Element'.
+template <class T, class Element = T>
+class ArrayAllocator {
+public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  ArrayAllocator() = default;
+  template <class U>
+  ArrayAllocator(const ArrayAllocator<U, Element>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    const std::size_t bytes = n * sizeof(T);
+    recordAllocation<Element>(bytes);
+    if (bytes < huge_page_size)
+      return std::allocator<T>().allocate(n);
+
+    const std::size_t padded = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    void* ptr = std::aligned_alloc(huge_page_size, padded);
+    if (!ptr)
+      throw std::bad_alloc();
+    advise(ptr, padded);
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    recordDeallocation<Element>(n * sizeof(T));
+    if (n * sizeof(T) < huge_page_size)
+      std::allocator<T>().deallocate(ptr, n);
+    else
+      std::free(ptr);
+  }
+
+  template <class U>
+  void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+    ::new (static_cast<void*>(ptr)) U;
+  }
+  template <class U, class... Args>
+  void construct(U* ptr, Args&&... args) {
+    ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  bool operator==(const ArrayAllocator<U, Element>&) const noexcept {
+    return true;
+  }
+
+private:
+  // Failures are ignored, as the hints do not affect correctness.
+  static void advise([[maybe_unused]] void* ptr, [[maybe_unused]] std::size_t bytes) noexcept {
+#ifdef __linux__
+    const auto& policy = getAllocationPolicy();
+#ifdef MADV_HUGEPAGE
+    if (bytes >= policy.huge_page_threshold)
+      madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+#ifdef SYS_mbind
+    if (policy.numa_node >= 0) {
+      constexpr int mpol_bind = 2;
+      constexpr std::size_t mask_bits = 8 * sizeof(unsigned long);
+      unsigned long mask[16] = {};
+      const std::size_t node = policy.numa_node;
+      if (node < mask_bits * 16) {
+        mask[node / mask_bits] = 1ul << (node % mask_bits);
+        syscall(SYS_mbind, ptr, bytes, mpol_bind, mask, mask_bits * 16 + 1, 0);
+      }
+    }
+#endif
+#endif
+  }
+};
+
+// Calls f(begin, end) on the ranges of [0, n) with the partitioning used to evaluate arrays, or
+// serially if parallel first touch is disabled.
+template <class F>
+void firstTouch(std::size_t n, F&& f) {
+  if (getAllocationPolicy().parallel_first_touch)
+    parallelFor(0, n, evaluation_grain, std::forward<F>(f));
+  else
+    f(0, n);
+}
+
+}  // namespace details
+}  // namespace nd
@@ -0,0 +1,147 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Expressions owning their operands, and their asynchronous evaluation on the thread pool.
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <future>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+// Read only array with shared ownership. Expressions store it by value, so that they can outlive
+// the scope of the array or be moved to another thread.
+template <class T, std::size_t dims>
+class SharedArray {
+public:
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = true;
+  constexpr static std::size_t dimensions = dims;
+
+  explicit SharedArray(std::shared_ptr<const NDArray<T, dims>> array) : array_(std::move(array)) {
+    assert(array_);
+  }
+
+  explicit SharedArray(NDArray<T, dims>&& array)
+      : array_(std::make_shared<const NDArray<T, dims>>(std::move(array))) {}
+
+  const auto& shape() const noexcept {
+    return array_->shape();
+  }
+
+  std::size_t size() const noexcept {
+    return array_->size();
+  }
+
+  const AxisOrder<dims>& order() const noexcept {
+    return array_->order();
+  }
+
+  const T& operator[](std::size_t idx) const noexcept {
+    return (*array_)[idx];
+  }
+
+  const T& operator()(const std::array<std::size_t, dims>& idx) const noexcept {
+    return (*array_)(idx);
+  }
+
+  template <std::size_t idx_size>
+  const T& extendedElement(const std::array<std::size_t, idx_size>& idx) const noexcept {
+    return array_->extendedElement(idx);
+  }
+
+  const NDArray<T, dims>& array() const noexcept {
+    return *array_;
+  }
+
+  long useCount() const noexcept {
+    return array_.use_count();
+  }
+
+private:
+  std::shared_ptr<const NDArray<T, dims>> array_;
+};
+
+template <class T, std::size_t dims>
+auto share(NDArray<T, dims>&& array) {
+  return SharedArray<T, dims>(std::move(array));
+}
+
+template <class T, std::size_t dims>
+auto share(std::shared_ptr<const NDArray<T, dims>> array) {
+  return SharedArray<T, dims>(std::move(array));
+}
+
+template <class T, std::size_t dims>
+auto share(std::shared_ptr<NDArray<T, dims>> array) {
+  return SharedArray<T, dims>(std::shared_ptr<const NDArray<T, dims>>(std::move(array)));
+}
+
+namespace details {
+
+template <class T>
+constexpr bool is_shared_array = false;
+template <class T, std::size_t dims>
+constexpr bool is_shared_array<SharedArray<T, dims>> = true;
+
+// True if E does not reference memory it does not own.
+template <class E>
+constexpr bool is_owning = std::is_scalar_v<E> || is_shared_array<E>;
+template <class F, class... Args>
+constexpr bool is_owning<LazyFunction<F, Args...>> = !std::is_reference_v<F> &&
+                                                     (is_owning<Args> && ...);
+
+}  // namespace details
+
+// Returns an equivalent expression which owns its operands: arrays and views which are not
+// already shared are copied into shared arrays.
+template <lazy_evaluated E>
+auto own(const E& e) {
+  if constexpr (details::is_owning<E>)
+    return e;
+  else if constexpr (details::is_lazy_function<E>) {
+    return std::apply(
+        [&](const auto&... args) {
+          using F = std::decay_t<decltype(e.function())>;
+          return nd::apply(F(e.function()), own(args)...);
+        },
+        e.arguments());
+  }
+  else {
+    using Array = NDArray<details::ElementType<E>, E::dimensions>;
+    return SharedArray<details::ElementType<E>, E::dimensions>(Array(e));
+  }
+}
+
+// Evaluates 'e' on a worker of the thread pool into a new array. The expression is first made
+// owning on the calling thread, copying the operands which are not shared arrays, so that they
+// can be modified or destroyed while the evaluation is in progress. The evaluation is serial on
+// the worker, so that independent evaluations proceed concurrently.
+template <nd_object E>
+auto asyncEval(const E& e) {
+  auto owned = own(e);
+  using Owned = decltype(owned);
+  using Result = NDArray<details::ElementType<E>, E::dimensions>;
+  return ThreadPool::getInstance().enqueue([owned = std::move(owned)]() {
+    if constexpr (details::is_shared_array<Owned>)
+      return Result(owned.array());
+    else
+      return Result(owned);
+  });
+}
+
+}  // namespace nd
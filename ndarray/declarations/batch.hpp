@@ -0,0 +1,314 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Batches of assignments, fused into common traversals and evaluated concurrently.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/nd_view.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+namespace details {
+
+// Elements evaluated by each assignment of a fused group before moving to the next one, so that
+// the operands shared by the group are still in cache.
+constexpr std::size_t fusion_block = 1 << 11;
+
+struct MemoryRange {
+  std::uintptr_t begin;
+  std::uintptr_t end;
+};
+
+template <class T>
+MemoryRange memoryRange(const T* data, std::size_t n) noexcept {
+  const auto begin = reinterpret_cast<std::uintptr_t>(data);
+  return {begin, begin + n * sizeof(T)};
+}
+
+// Memory written and read by an assignment.
+struct Access {
+  MemoryRange write{};
+  std::vector<MemoryRange> reads;
+  bool unknown = false;  // Reads objects whose memory is not known, e.g. user defined ones.
+};
+
+template <class E>
+void collectReads(const E& x, Access& access) {
+  if constexpr (std::is_scalar_v<E>) {
+  }
+  else if constexpr (is_lazy_function<E>) {
+    for_each_in_tuple(x.arguments(), [&](const auto& arg) { collectReads(arg, access); });
+  }
+  else if constexpr (is_nd_array<E>) {
+    access.reads.push_back(memoryRange(x.data(), x.size()));
+  }
+  else if constexpr (is_nd_view<E>) {
+    std::size_t extent = 1;
+    for (std::size_t d = 0; d < E::dimensions; ++d) {
+      if (x.shape()[d] == 0)
+        return;
+      extent += (x.shape()[d] - 1) * x.strides()[d];
+    }
+    access.reads.push_back(memoryRange(x.data(), extent));
+  }
+  else {
+    access.unknown = true;
+  }
+}
+
+// Memory dependency between two assignments. Exact dependencies only involve whole arrays
+// accessed at the same index, and do not prevent fusing linear assignments.
+enum struct Dependency { none, exact, partial };
+
+inline Dependency dependency(const Access& a, const Access& b) {
+  if (a.unknown || b.unknown)
+    return Dependency::partial;
+
+  Dependency result = Dependency::none;
+  auto check = [&](const MemoryRange& x, const MemoryRange& y) {
+    if (x.begin >= y.end || y.begin >= x.end)
+      return;
+    if (x.begin == y.begin && x.end == y.end)
+      result = std::max(result, Dependency::exact);
+    else
+      result = Dependency::partial;
+  };
+  check(a.write, b.write);
+  for (const auto& read : b.reads)
+    check(a.write, read);
+  for (const auto& read : a.reads)
+    check(read, b.write);
+  return result;
+}
+
+struct BatchTask {
+  // Evaluates the elements [begin, end) in storage order, or the whole assignment if the task is
+  // not divisible.
+  std::function<void(std::size_t, std::size_t)> evaluate;
+  std::function<void(Access&)> access;
+  std::size_t size;
+  // Linear assignments of the same shape and axis order can be fused.
+  bool linear;
+  bool divisible;
+  std::vector<std::size_t> shape;
+  std::vector<std::size_t> order;
+};
+
+}  // namespace details
+
+// Records assignments and evaluates them together. Assignments are grouped, in recording order,
+// with previous linear assignments of the same shape and axis order, unless a dependency on an
+// assignment recorded in between, or a partial overlap of their memory, prevents it. Each group
+// is evaluated by a single traversal, block by block. Groups without dependencies between them
+// are evaluated concurrently. The result is the same as evaluating the assignments in order.
+// E.g.
+// nd::batch([&](nd::Batch& b) {
+//   b.assign(E, A + B);
+//   b.assign(F, A * C);
+//   b.assign(G, E * F + 1);  // A single traversal of A, B, C, E, F and G.
+// });
+class Batch {
+public:
+  Batch() = default;
+  Batch(const Batch&) = delete;
+  Batch& operator=(const Batch&) = delete;
+
+  // Records destination = f. The destination is reshaped immediately if needed. The operands of
+  // 'f' are referenced as in any expression and must be valid until run() is called.
+  template <class T, std::size_t dims, class F, class... Args>
+  void assign(NDArray<T, dims>& destination, const LazyFunction<F, Args...>& f) {
+    static_assert(LazyFunction<F, Args...>::dimensions == dims, "Dimensions not compatible.");
+    if (destination.shape() != f.shape())
+      destination.reshape(f.shape());
+
+    details::BatchTask task = makeTask(destination);
+    task.linear = details::isLinear(f, destination.shape(), destination.order());
+    task.divisible = task.linear || details::isRowMajor(destination.order());
+    task.access = [&destination, f](details::Access& access) {
+      access.write = details::memoryRange(destination.data(), destination.size());
+      details::collectReads(f, access);
+    };
+
+    if (task.linear) {
+      task.evaluate = [&destination, f](std::size_t begin, std::size_t end) {
+        T* const out = destination.data();
+        if constexpr (LazyFunction<F, Args...>::contiguous_storage) {
+          for (std::size_t i = begin; i < end; ++i)
+            out[i] = f[i];
+        }
+      };
+    }
+    else if (task.divisible) {
+      task.evaluate = [&destination, f](std::size_t begin, std::size_t end) {
+        T* pos = destination.data() + begin;
+        const bool extended = f.broadcasted();
+        broadcastShapeRange(
+            [&](const auto& index) { *pos++ = details::elementAt(f, index, extended); },
+            destination.shape(), begin, end);
+      };
+    }
+    else {
+      task.evaluate = [&destination, f](std::size_t, std::size_t) { destination = f; };
+    }
+    tasks_.push_back(std::move(task));
+  }
+
+  template <class T, std::size_t dims>
+  void assign(NDArray<T, dims>& destination, const T& value) {
+    details::BatchTask task = makeTask(destination);
+    task.linear = task.divisible = true;
+    task.access = [&destination](details::Access& access) {
+      access.write = details::memoryRange(destination.data(), destination.size());
+    };
+    task.evaluate = [&destination, value](std::size_t begin, std::size_t end) {
+      std::fill(destination.data() + begin, destination.data() + end, value);
+    };
+    tasks_.push_back(std::move(task));
+  }
+
+  // Number of recorded assignments.
+  std::size_t size() const noexcept {
+    return tasks_.size();
+  }
+
+  // Indices of the recorded assignments evaluated by each traversal, ordered by their first one.
+  std::vector<std::vector<std::size_t>> groups() const {
+    std::vector<std::vector<std::size_t>> result;
+    for (const auto& group : plan())
+      result.push_back(group.tasks);
+    return result;
+  }
+
+  // Evaluates the recorded assignments and clears them. Groups are evaluated by waves of
+  // independent groups, each wave by a single parallel loop over the concatenation of its groups.
+  void run() {
+    const auto groups = plan();
+    std::size_t n_levels = 0;
+    for (const auto& group : groups)
+      n_levels = std::max(n_levels, group.level + 1);
+
+    for (std::size_t level = 0; level < n_levels; ++level) {
+      std::vector<const Group*> wave;
+      std::vector<std::size_t> offsets{0};
+      for (const auto& group : groups)
+        if (group.level == level) {
+          wave.push_back(&group);
+          offsets.push_back(offsets.back() + tasks_[group.tasks[0]].size);
+        }
+
+      parallelFor(0, offsets.back(), details::evaluation_grain,
+                  [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t g = 0; g < wave.size(); ++g) {
+                      const std::size_t b = std::max(begin, offsets[g]);
+                      const std::size_t e = std::min(end, offsets[g + 1]);
+                      if (b < e)
+                        evaluateGroup(*wave[g], b - offsets[g], e - offsets[g]);
+                    }
+                  });
+    }
+    tasks_.clear();
+  }
+
+private:
+  struct Group {
+    std::vector<std::size_t> tasks;
+    std::size_t level = 0;
+  };
+
+  template <class T, std::size_t dims>
+  static details::BatchTask makeTask(const NDArray<T, dims>& destination) {
+    details::BatchTask task;
+    task.size = destination.size();
+    task.shape.assign(destination.shape().begin(), destination.shape().end());
+    task.order.assign(destination.order().begin(), destination.order().end());
+    return task;
+  }
+
+  std::vector<Group> plan() const {
+    std::vector<details::Access> accesses(tasks_.size());
+    for (std::size_t i = 0; i < tasks_.size(); ++i)
+      tasks_[i].access(accesses[i]);
+
+    auto depends = [&](const Group& group, std::size_t j, bool allow_exact) {
+      for (std::size_t i : group.tasks) {
+        const auto dependency = details::dependency(accesses[i], accesses[j]);
+        if (dependency == details::Dependency::partial ||
+            (dependency == details::Dependency::exact && !allow_exact))
+          return true;
+      }
+      return false;
+    };
+
+    std::vector<Group> groups;
+    for (std::size_t j = 0; j < tasks_.size(); ++j) {
+      const auto& task = tasks_[j];
+      // Joins the latest compatible group, unless it depends on a group recorded after it.
+      bool joined = false;
+      for (std::size_t g = groups.size(); g-- > 0 && task.linear;) {
+        const auto& first = tasks_[groups[g].tasks[0]];
+        if (first.linear && first.shape == task.shape && first.order == task.order &&
+            !depends(groups[g], j, true)) {
+          groups[g].tasks.push_back(j);
+          joined = true;
+          break;
+        }
+        if (depends(groups[g], j, false))
+          break;
+      }
+      if (!joined)
+        groups.push_back(Group{{j}, 0});
+    }
+
+    // Groups only depend on groups created before them.
+    for (std::size_t g = 0; g < groups.size(); ++g)
+      for (std::size_t h = 0; h < g; ++h) {
+        bool dependent = false;
+        for (std::size_t j : groups[g].tasks)
+          dependent = dependent || depends(groups[h], j, false);
+        if (dependent)
+          groups[g].level = std::max(groups[g].level, groups[h].level + 1);
+      }
+    return groups;
+  }
+
+  void evaluateGroup(const Group& group, std::size_t begin, std::size_t end) const {
+    const auto& first = tasks_[group.tasks[0]];
+    if (!first.divisible) {
+      // Evaluated entirely by the thread that owns its first element.
+      if (begin == 0)
+        first.evaluate(0, first.size);
+      return;
+    }
+    for (std::size_t block = begin; block < end; block += details::fusion_block) {
+      const std::size_t block_end = std::min(end, block + details::fusion_block);
+      for (std::size_t i : group.tasks)
+        tasks_[i].evaluate(block, block_end);
+    }
+  }
+
+  std::vector<details::BatchTask> tasks_;
+};
+
+// Records the assignments made by f(batch) and evaluates them.
+template <class F>
+void batch(F&& f) {
+  Batch b;
+  f(b);
+  b.run();
+}
+
+}  // namespace nd
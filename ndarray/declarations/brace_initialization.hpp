@@ -34,8 +34,8 @@ using NDInitializer = typename details::NDInitializerImpl<T, dims>::type;
 
 namespace details {
 
-template <class T, std::size_t dims>
-void readData(std::vector<T>& data, std::size_t* shape,
+template <class T, std::size_t dims, class Stored, class Allocator>
+void readData(std::vector<Stored, Allocator>& data, std::size_t* shape,
               NDInitializer<T, dims> list) {
   if (*shape == 0) {
     *shape = list.size();
@@ -56,8 +56,8 @@ void readData(std::vector<T>& data, std::size_t* shape,
 
 }  // namespace details
 
-template <class T, std::size_t dims>
-void readData(std::vector<T>& data, std::array<std::size_t, dims>& shape,
+template <class T, std::size_t dims, class Stored, class Allocator>
+void readData(std::vector<Stored, Allocator>& data, std::array<std::size_t, dims>& shape,
               NDInitializer<T, dims> list) {
   details::readData<T, dims>(data, shape.data(), list);
 }
@@ -14,6 +14,8 @@
 #include <stdexcept>
 #include <utility>
 
+#include "ndarray/declarations/trace.hpp"
+
 namespace nd {
 
 template <std::size_t I1, std::size_t... Is>
@@ -33,9 +35,10 @@ bool combineShapes(std::array<std::size_t, n1>& s1,
   constexpr std::size_t shift = n1 - n2;
   bool broadcasted = n1 != n2;
   for (unsigned i = 0; i < n2; ++i) {
-    assert(s1[i+shift] == s2[i] || s1[i+shift] == 0 || s1[i+shift] == 1 || s2[i] == 1);
-    s1[i + shift] = std::max(s1[i + shift], s2[i]);
-    broadcasted |= s1[i + shift] != 0 && s1[i + shift] != s2[i];
+    const std::size_t previous = s1[i + shift];
+    assert(previous == s2[i] || previous == 0 || previous == 1 || s2[i] == 1);
+    s1[i + shift] = std::max(previous, s2[i]);
+    broadcasted |= previous != 0 && previous != s2[i];
   }
 
   return broadcasted;
@@ -100,6 +103,8 @@ struct Iterate<dims, dims, mode> {
 template <class F, class... Views>
 void broadcast(F&& f, Views&&... views) {
   const auto [shape, broadcast] = getBroadcastShape(views.shape()...);
+  const auto span = details::evaluationSpan<void(std::decay_t<F>, std::decay_t<Views>...)>(
+      "broadcast", shape, broadcast ? "broadcast" : "strided");
 
   constexpr std::size_t dims = pack_max<std::decay_t<Views>::dimensions...>;
   std::array<std::size_t, dims> index;
@@ -150,5 +155,29 @@ void broadcastShape(F&& f, const T& tensor) {
   broadcastShape(std::forward<F>(f), tensor.shape());
 }
 
+// Calls f(index) on the indices with row major linear position in [begin, end).
+template <class F, std::size_t dims>
+void broadcastShapeRange(F&& f, const std::array<std::size_t, dims>& shape, std::size_t begin,
+                         std::size_t end) {
+  if (begin >= end)
+    return;
+
+  std::array<std::size_t, dims> index;
+  std::size_t rest = begin;
+  for (int i = int(dims) - 1; i >= 0; --i) {
+    index[i] = rest % shape[i];
+    rest /= shape[i];
+  }
+
+  for (std::size_t lin = begin; lin < end; ++lin) {
+    f(index);
+    for (int i = int(dims) - 1; i >= 0; --i) {
+      if (++index[i] < shape[i])
+        break;
+      index[i] = 0;
+    }
+  }
+}
+
 
 }  // namespace nd
@@ -0,0 +1,309 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Compressed files of arrays: byte shuffled chunks encoded with a fast LZ77 codec.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "ndarray/declarations/dlpack.hpp"
+#include "ndarray/declarations/layout.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+namespace details {
+
+constexpr std::array<char, 4> compressed_magic{'N', 'D', 'Z', '1'};
+constexpr std::size_t default_chunk_bytes = 1 << 18;
+
+// Groups the k-th byte of every element of size 'size', so that the slowly varying exponent and
+// high mantissa bytes of smooth fields form long repeated runs.
+inline void shuffleBytes(const std::uint8_t* in, std::size_t n, std::size_t size,
+                         std::uint8_t* out) noexcept {
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t b = 0; b < size; ++b)
+      out[b * n + i] = in[i * size + b];
+}
+
+inline void unshuffleBytes(const std::uint8_t* in, std::size_t n, std::size_t size,
+                           std::uint8_t* out) noexcept {
+  for (std::size_t b = 0; b < size; ++b)
+    for (std::size_t i = 0; i < n; ++i)
+      out[i * size + b] = in[b * n + i];
+}
+
+inline void writeVarint(std::vector<std::uint8_t>& out, std::size_t value) {
+  while (value >= 0x80) {
+    out.push_back(std::uint8_t(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(std::uint8_t(value));
+}
+
+inline std::size_t readVarint(const std::uint8_t*& in, const std::uint8_t* end) {
+  std::size_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (in == end)
+      break;
+    const std::uint8_t byte = *in++;
+    value |= std::size_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+  throw(std::runtime_error("Corrupted compressed data."));
+}
+
+inline std::uint32_t load32(const std::uint8_t* p) noexcept {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// LZ77 with a single entry hash table of 4 byte sequences. The output is a list of sequences
+// (literal length, literals, match length, match offset), lengths and offsets being varints. The
+// last sequence has no match.
+inline std::vector<std::uint8_t> lzCompress(const std::uint8_t* in, std::size_t n) {
+  constexpr unsigned hash_bits = 14;
+  constexpr std::size_t min_match = 4;
+  std::vector<std::uint32_t> table(std::size_t(1) << hash_bits, 0);
+  std::vector<std::uint8_t> out;
+  out.reserve(n / 2 + 16);
+
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+  while (i + min_match <= n) {
+    const std::uint32_t value = load32(in + i);
+    const std::uint32_t hash = (value * 2654435761u) >> (32 - hash_bits);
+    const std::size_t candidate = table[hash];
+    table[hash] = std::uint32_t(i + 1);
+
+    if (candidate == 0 || load32(in + candidate - 1) != value) {
+      ++i;
+      continue;
+    }
+    const std::size_t match = candidate - 1;
+    std::size_t length = min_match;
+    while (i + length < n && in[match + length] == in[i + length])
+      ++length;
+
+    writeVarint(out, i - anchor);
+    out.insert(out.end(), in + anchor, in + i);
+    writeVarint(out, length - min_match + 1);
+    writeVarint(out, i - match);
+    i += length;
+    anchor = i;
+  }
+  writeVarint(out, n - anchor);
+  out.insert(out.end(), in + anchor, in + n);
+  writeVarint(out, 0);
+  return out;
+}
+
+// Decodes exactly 'n' bytes into 'out'. Throws std::runtime_error if the input is corrupted.
+inline void lzDecompress(const std::uint8_t* in, std::size_t in_size, std::uint8_t* out,
+                         std::size_t n) {
+  constexpr std::size_t min_match = 4;
+  const std::uint8_t* const in_end = in + in_size;
+  std::size_t pos = 0;
+  while (true) {
+    const std::size_t literals = readVarint(in, in_end);
+    if (literals > std::size_t(in_end - in) || literals > n - pos)
+      throw(std::runtime_error("Corrupted compressed data."));
+    std::memcpy(out + pos, in, literals);
+    in += literals;
+    pos += literals;
+
+    const std::size_t length = readVarint(in, in_end);
+    if (length == 0)
+      break;
+    const std::size_t offset = readVarint(in, in_end);
+    const std::size_t match_length = length - 1 + min_match;
+    if (offset == 0 || offset > pos || match_length > n - pos)
+      throw(std::runtime_error("Corrupted compressed data."));
+    // The match may overlap the bytes it produces.
+    for (std::size_t k = 0; k < match_length; ++k, ++pos)
+      out[pos] = out[pos - offset];
+  }
+  if (pos != n)
+    throw(std::runtime_error("Corrupted compressed data."));
+}
+
+// Encodes a chunk of 'n' elements of 'size' bytes. The first byte tells whether the chunk is
+// compressed or stored raw, when compression does not reduce its size.
+inline std::vector<std::uint8_t> encodeChunk(const std::uint8_t* in, std::size_t n,
+                                             std::size_t size) {
+  const std::size_t bytes = n * size;
+  std::vector<std::uint8_t> shuffled(bytes);
+  shuffleBytes(in, n, size, shuffled.data());
+  std::vector<std::uint8_t> compressed = lzCompress(shuffled.data(), bytes);
+
+  std::vector<std::uint8_t> result;
+  if (compressed.size() < bytes) {
+    result.reserve(compressed.size() + 1);
+    result.push_back(1);
+    result.insert(result.end(), compressed.begin(), compressed.end());
+  }
+  else {
+    result.reserve(bytes + 1);
+    result.push_back(0);
+    result.insert(result.end(), in, in + bytes);
+  }
+  return result;
+}
+
+// Decodes a chunk directly into its place in the destination array.
+inline void decodeChunk(const std::uint8_t* in, std::size_t in_size, std::size_t n,
+                        std::size_t size, std::uint8_t* out) {
+  const std::size_t bytes = n * size;
+  if (in_size == 0 || in[0] > 1)
+    throw(std::runtime_error("Corrupted compressed data."));
+  if (in[0] == 0) {
+    if (in_size - 1 != bytes)
+      throw(std::runtime_error("Corrupted compressed data."));
+    std::memcpy(out, in + 1, bytes);
+  }
+  else if (size == 1) {
+    lzDecompress(in + 1, in_size - 1, out, bytes);
+  }
+  else {
+    std::vector<std::uint8_t> shuffled(bytes);
+    lzDecompress(in + 1, in_size - 1, shuffled.data(), bytes);
+    unshuffleBytes(shuffled.data(), n, size, out);
+  }
+}
+
+template <class T>
+void writeValue(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+T readValue(std::istream& in) {
+  T value;
+  in.read(reinterpret_cast<char*>(&value), sizeof(T));
+  if (!in)
+    throw(std::runtime_error("Truncated compressed array."));
+  return value;
+}
+
+}  // namespace details
+
+// Writes 'array' in chunks of about 'chunk_bytes', byte shuffled and compressed in parallel. The
+// header stores the element type, shape and axis order. Integers are written in the byte order of
+// the host.
+template <class T, std::size_t dims>
+void saveCompressed(std::ostream& out, const NDArray<T, dims>& array,
+                    std::size_t chunk_bytes = details::default_chunk_bytes) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  const std::size_t chunk = std::max<std::size_t>(1, chunk_bytes / sizeof(T));
+  const std::size_t n_chunks = (array.size() + chunk - 1) / chunk;
+  const auto* const data = reinterpret_cast<const std::uint8_t*>(array.data());
+
+  std::vector<std::vector<std::uint8_t>> encoded(n_chunks);
+  parallelFor(0, n_chunks, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t c = begin; c < end; ++c) {
+      const std::size_t n = std::min(chunk, array.size() - c * chunk);
+      encoded[c] = details::encodeChunk(data + c * chunk * sizeof(T), n, sizeof(T));
+    }
+  });
+
+  const DLDataType type = details::dlpackType<T>();
+  out.write(details::compressed_magic.data(), details::compressed_magic.size());
+  details::writeValue(out, type);
+  details::writeValue(out, std::uint32_t(dims));
+  for (std::size_t d = 0; d < dims; ++d)
+    details::writeValue(out, std::uint64_t(array.shape()[d]));
+  for (std::size_t d = 0; d < dims; ++d)
+    details::writeValue(out, std::uint32_t(array.order()[d]));
+  details::writeValue(out, std::uint64_t(chunk));
+  for (const auto& bytes : encoded)
+    details::writeValue(out, std::uint64_t(bytes.size()));
+  for (const auto& bytes : encoded)
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  if (!out)
+    throw(std::runtime_error("Can not write compressed array."));
+}
+
+template <class T, std::size_t dims>
+void saveCompressed(const std::filesystem::path& path, const NDArray<T, dims>& array,
+                    std::size_t chunk_bytes = details::default_chunk_bytes) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out)
+    throw(std::runtime_error("Can not create file " + path.string()));
+  saveCompressed(out, array, chunk_bytes);
+}
+
+// Reads an array written by saveCompressed, decompressing the chunks in parallel into the storage
+// of the result. Throws std::runtime_error if the type or rank differ, or the data is corrupted.
+template <class T, std::size_t dims>
+NDArray<T, dims> loadCompressed(std::istream& in) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  std::array<char, 4> magic;
+  in.read(magic.data(), magic.size());
+  if (!in || magic != details::compressed_magic)
+    throw(std::runtime_error("Not a compressed array."));
+
+  const DLDataType type = details::readValue<DLDataType>(in);
+  const DLDataType expected = details::dlpackType<T>();
+  if (type.code != expected.code || type.bits != expected.bits || type.lanes != expected.lanes ||
+      details::readValue<std::uint32_t>(in) != dims)
+    throw(std::runtime_error("Compressed array of different type or dimensions."));
+
+  std::array<std::size_t, dims> shape;
+  AxisOrder<dims> order;
+  for (std::size_t d = 0; d < dims; ++d)
+    shape[d] = details::readValue<std::uint64_t>(in);
+  for (std::size_t d = 0; d < dims; ++d)
+    order[d] = details::readValue<std::uint32_t>(in);
+  if (!details::isPermutation(order))
+    throw(std::runtime_error("Corrupted compressed data."));
+  const std::size_t chunk = details::readValue<std::uint64_t>(in);
+
+  NDArray<T, dims> result(shape, order);
+  if (chunk == 0 && result.size())
+    throw(std::runtime_error("Corrupted compressed data."));
+  const std::size_t n_chunks = result.size() ? (result.size() + chunk - 1) / chunk : 0;
+
+  std::vector<std::size_t> offsets(n_chunks + 1, 0);
+  for (std::size_t c = 0; c < n_chunks; ++c)
+    offsets[c + 1] = offsets[c] + details::readValue<std::uint64_t>(in);
+  std::vector<std::uint8_t> payload(offsets.back());
+  in.read(reinterpret_cast<char*>(payload.data()), payload.size());
+  if (!in)
+    throw(std::runtime_error("Truncated compressed array."));
+
+  auto* const data = reinterpret_cast<std::uint8_t*>(result.data());
+  parallelFor(0, n_chunks, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t c = begin; c < end; ++c) {
+      const std::size_t n = std::min(chunk, result.size() - c * chunk);
+      details::decodeChunk(payload.data() + offsets[c], offsets[c + 1] - offsets[c], n,
+                           sizeof(T), data + c * chunk * sizeof(T));
+    }
+  });
+  return result;
+}
+
+template <class T, std::size_t dims>
+NDArray<T, dims> loadCompressed(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw(std::runtime_error("Can not open file " + path.string()));
+  return loadCompressed<T, dims>(in);
+}
+
+}  // namespace nd
@@ -0,0 +1,237 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Exchange of arrays with other libraries, e.g. NumPy or PyTorch, through DLPack.
+
+#pragma once
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/nd_view.hpp"
+
+#if __has_include(<dlpack/dlpack.h>)
+#include <dlpack/dlpack.h>
+#endif
+
+// Without the DLPack header, declare the structures of its ABI. The include guard prevents a
+// later inclusion of the header from redefining them.
+#ifndef DLPACK_DLPACK_H_
+#define DLPACK_DLPACK_H_
+
+extern "C" {
+
+typedef enum {
+  kDLCPU = 1,
+  kDLCUDA = 2,
+  kDLCUDAHost = 3,
+  kDLOpenCL = 4,
+  kDLVulkan = 7,
+  kDLMetal = 8,
+  kDLVPI = 9,
+  kDLROCM = 10,
+  kDLROCMHost = 11,
+  kDLExtDev = 12,
+  kDLCUDAManaged = 13,
+  kDLOneAPI = 14,
+  kDLWebGPU = 15,
+  kDLHexagon = 16,
+} DLDeviceType;
+
+typedef struct {
+  DLDeviceType device_type;
+  int32_t device_id;
+} DLDevice;
+
+typedef enum {
+  kDLInt = 0U,
+  kDLUInt = 1U,
+  kDLFloat = 2U,
+  kDLOpaqueHandle = 3U,
+  kDLBfloat = 4U,
+  kDLComplex = 5U,
+  kDLBool = 6U,
+} DLDataTypeCode;
+
+typedef struct {
+  uint8_t code;
+  uint8_t bits;
+  uint16_t lanes;
+} DLDataType;
+
+typedef struct {
+  void* data;
+  DLDevice device;
+  int32_t ndim;
+  DLDataType dtype;
+  int64_t* shape;
+  int64_t* strides;
+  uint64_t byte_offset;
+} DLTensor;
+
+typedef struct DLManagedTensor {
+  DLTensor dl_tensor;
+  void* manager_ctx;
+  void (*deleter)(struct DLManagedTensor* self);
+} DLManagedTensor;
+
+}  // extern "C"
+
+#endif  // DLPACK_DLPACK_H_
+
+namespace nd {
+namespace details {
+
+template <class T>
+constexpr DLDataType dlpackType() {
+  using U = std::remove_const_t<T>;
+  if constexpr (std::is_same_v<U, bool>)
+    return {kDLBool, 8, 1};
+  else if constexpr (std::is_integral_v<U>)
+    return {std::uint8_t(std::is_signed_v<U> ? kDLInt : kDLUInt), 8 * sizeof(U), 1};
+  else if constexpr (std::is_floating_point_v<U>)
+    return {kDLFloat, 8 * sizeof(U), 1};
+  else if constexpr (std::is_same_v<U, std::complex<float>> ||
+                     std::is_same_v<U, std::complex<double>>)
+    return {kDLComplex, 8 * sizeof(U), 1};
+  else
+    static_assert(std::is_void_v<T>, "Element type not supported by DLPack.");
+}
+
+// Owner of the exported array and of the shape and strides the tensor points to.
+template <class Owner, std::size_t dims>
+struct DLPackContext {
+  DLManagedTensor tensor;
+  Owner owner;
+  std::array<std::int64_t, dims> shape;
+  std::array<std::int64_t, dims> strides;
+};
+
+template <class Owner, class T, std::size_t dims>
+DLManagedTensor* exportTensor(Owner&& owner, const NDView<T, dims>& view) {
+  using Context = DLPackContext<std::decay_t<Owner>, dims>;
+  auto context = std::make_unique<Context>(Context{{}, std::forward<Owner>(owner), {}, {}});
+  for (std::size_t d = 0; d < dims; ++d) {
+    context->shape[d] = view.shape()[d];
+    context->strides[d] = view.strides()[d];
+  }
+
+  DLTensor& tensor = context->tensor.dl_tensor;
+  tensor.data = const_cast<std::remove_const_t<T>*>(view.data());
+  tensor.device = {kDLCPU, 0};
+  tensor.ndim = dims;
+  tensor.dtype = dlpackType<T>();
+  tensor.shape = context->shape.data();
+  tensor.strides = context->strides.data();
+  tensor.byte_offset = 0;
+  context->tensor.manager_ctx = context.get();
+  context->tensor.deleter = [](DLManagedTensor* self) {
+    delete static_cast<Context*>(self->manager_ctx);
+  };
+  return &context.release()->tensor;
+}
+
+struct NoOwner {};
+
+}  // namespace details
+
+// Exports 'array' without copying. The returned tensor owns the array until its deleter is
+// called by the consumer.
+template <class T, std::size_t dims>
+DLManagedTensor* toDLPack(NDArray<T, dims>&& array) {
+  const NDView<T, dims> view = array;
+  return details::exportTensor(std::move(array), view);
+}
+
+template <class T, std::size_t dims>
+DLManagedTensor* toDLPack(std::shared_ptr<NDArray<T, dims>> array) {
+  const NDView<T, dims> view = *array;
+  return details::exportTensor(std::move(array), view);
+}
+
+// Exports a view. The viewed memory must outlive the use of the tensor.
+template <class T, std::size_t dims>
+DLManagedTensor* toDLPack(const NDView<T, dims>& view) {
+  return details::exportTensor(details::NoOwner{}, view);
+}
+
+// Imported DLPack tensor, viewed without copying. Calls the deleter of the tensor when destroyed.
+template <class T, std::size_t dims>
+class DLPackView {
+public:
+  // Takes ownership of 'tensor'. Throws std::invalid_argument, after calling its deleter, if the
+  // tensor is not in host memory or does not have the element type and dimensions of the view.
+  explicit DLPackView(DLManagedTensor* tensor) : tensor_(tensor) {
+    if (!tensor_)
+      throw(std::invalid_argument("Null DLPack tensor."));
+    try {
+      import(tensor_->dl_tensor);
+    }
+    catch (...) {
+      if (tensor_->deleter)
+        tensor_->deleter(tensor_);
+      throw;
+    }
+  }
+
+  DLPackView(DLPackView&& rhs) noexcept : tensor_(std::exchange(rhs.tensor_, nullptr)) {
+    view_.shallowCopy(rhs.view_);
+  }
+  DLPackView& operator=(DLPackView&& rhs) noexcept {
+    std::swap(tensor_, rhs.tensor_);
+    const NDView<T, dims> view = view_;
+    view_.shallowCopy(rhs.view_);
+    rhs.view_.shallowCopy(view);
+    return *this;
+  }
+  DLPackView(const DLPackView&) = delete;
+  DLPackView& operator=(const DLPackView&) = delete;
+
+  ~DLPackView() {
+    if (tensor_ && tensor_->deleter)
+      tensor_->deleter(tensor_);
+  }
+
+  const NDView<T, dims>& view() const noexcept {
+    return view_;
+  }
+  operator NDView<T, dims>() const noexcept {
+    return view_;
+  }
+
+private:
+  void import(const DLTensor& t) {
+    const DLDataType type = details::dlpackType<T>();
+
+    if (t.device.device_type != kDLCPU && t.device.device_type != kDLCUDAHost)
+      throw(std::invalid_argument("DLPack tensor not in host memory."));
+    if (t.ndim != int(dims) || t.dtype.code != type.code || t.dtype.bits != type.bits ||
+        t.dtype.lanes != type.lanes)
+      throw(std::invalid_argument("DLPack tensor of different type or dimensions."));
+
+    std::array<std::size_t, dims> shape, strides;
+    std::size_t stride = 1;
+    for (int d = int(dims) - 1; d >= 0; --d) {
+      shape[d] = t.shape[d];
+      if (t.strides && t.strides[d] < 0)
+        throw(std::invalid_argument("Negative DLPack strides are not supported."));
+      strides[d] = t.strides ? std::size_t(t.strides[d]) : stride;
+      stride *= shape[d];
+    }
+    auto* const data = reinterpret_cast<T*>(static_cast<char*>(t.data) + t.byte_offset);
+    view_.shallowCopy(NDView<T, dims>(data, shape, strides));
+  }
+
+  DLManagedTensor* tensor_ = nullptr;
+  NDView<T, dims> view_ = NDView<T, dims>(nullptr, {}, {});
+};
+
+}  // namespace nd
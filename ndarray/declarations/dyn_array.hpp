@@ -0,0 +1,406 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Array whose rank is known only at runtime, evaluated by the fixed rank kernels.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ndarray/declarations/layout.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/nd_view.hpp"
+
+// Maximum rank of a DynArray. Each expression is compiled once for every rank up to it.
+#ifndef NDARRAY_MAX_RANK
+#define NDARRAY_MAX_RANK 6
+#endif
+
+namespace nd {
+
+template <class T>
+class DynArray;
+template <class F, class... Args>
+class DynFunction;
+
+namespace details {
+
+constexpr std::size_t max_rank = NDARRAY_MAX_RANK;
+static_assert(max_rank >= 1);
+
+template <class T>
+constexpr bool is_dyn_array = false;
+template <class T>
+constexpr bool is_dyn_array<DynArray<T>> = true;
+
+template <class T>
+constexpr bool is_dyn_function = false;
+template <class F, class... Args>
+constexpr bool is_dyn_function<DynFunction<F, Args...>> = true;
+
+template <class T>
+constexpr bool is_dyn = is_dyn_array<T> || is_dyn_function<T>;
+
+// Calls f(std::integral_constant<std::size_t, rank>()). The result must not depend on the rank.
+template <std::size_t rank = 1, class F>
+decltype(auto) dispatchRank(std::size_t n, F&& f) {
+  if constexpr (rank == max_rank) {
+    if (n != rank)
+      throw(std::invalid_argument("Rank " + std::to_string(n) + " not in [1, " +
+                                  std::to_string(max_rank) + "]."));
+    return f(std::integral_constant<std::size_t, rank>());
+  }
+  else {
+    if (n == rank)
+      return f(std::integral_constant<std::size_t, rank>());
+    return dispatchRank<rank + 1>(n, std::forward<F>(f));
+  }
+}
+
+// Row major contiguous view, used as the operand of fixed rank expressions so that they are
+// evaluated by linear loops.
+template <class T, std::size_t dims>
+class DenseView {
+public:
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = true;
+  constexpr static std::size_t dimensions = dims;
+  using value_type = T;
+
+  DenseView(const T* data, const std::array<std::size_t, dims>& shape) noexcept
+      : data_(data), shape_(shape), strides_(contiguousStrides<dims>(shape, layout::right)) {}
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+  AxisOrder<dims> order() const noexcept {
+    return layout::right;
+  }
+
+  const T& operator[](std::size_t i) const noexcept {
+    return data_[i];
+  }
+  const T& operator()(const std::array<std::size_t, dims>& idx) const noexcept {
+    std::size_t offset = 0;
+    for (std::size_t d = 0; d < dims; ++d)
+      offset += idx[d] * strides_[d];
+    return data_[offset];
+  }
+
+  template <std::size_t idx_size> requires(idx_size >= dims)
+  const T& extendedElement(const std::array<std::size_t, idx_size>& idx) const noexcept {
+    std::size_t offset = 0;
+    for (std::size_t d = 0; d < dims; ++d)
+      offset += shape_[d] > 1 ? idx[d + idx_size - dims] * strides_[d] : 0;
+    return data_[offset];
+  }
+
+private:
+  const T* data_;
+  std::array<std::size_t, dims> shape_;
+  std::array<std::size_t, dims> strides_;
+};
+
+// Operand of a fixed rank expression of rank N.
+template <std::size_t N, class A>
+auto fixedRank(const A& a) {
+  if constexpr (is_dyn_array<A>)
+    return a.template dense<N>();
+  else if constexpr (is_dyn_function<A>)
+    return a.template fixed<N>();
+  else
+    return a;
+}
+
+template <class A>
+std::size_t rankOf(const A& a) {
+  if constexpr (is_dyn<A>)
+    return a.rank();
+  else
+    return 0;
+}
+
+// Element type of a DynArray, DynFunction or scalar.
+template <class A>
+struct DynElementImpl {
+  using type = A;
+};
+template <class A> requires is_dyn<A>
+struct DynElementImpl<A> {
+  using type = typename A::value_type;
+};
+template <class A>
+using DynElement = typename DynElementImpl<A>::type;
+
+}  // namespace details
+
+template <class T>
+concept dyn_evaluated = details::is_dyn<T> || std::is_scalar_v<T>;
+
+// Contiguous row major array of runtime rank. It converts without copies to an NDView of its rank,
+// and expressions of DynArrays are dispatched once on the rank to the compiled fixed rank
+// expression, e.g. DynArray c = a * b + 2.;
+template <class T>
+class DynArray {
+public:
+  using value_type = T;
+
+  DynArray() = default;
+  explicit DynArray(std::vector<std::size_t> shape) {
+    reshape(std::move(shape));
+  }
+
+  // Copy of a fixed rank array, or evaluation of a fixed rank expression.
+  template <nd_object E> requires(std::decay_t<E>::dimensions <= details::max_rank)
+  DynArray(const E& e) {
+    *this = e;
+  }
+
+  template <class F, class... Args>
+  DynArray(const DynFunction<F, Args...>& f) {
+    *this = f;
+  }
+
+  template <nd_object E> requires(std::decay_t<E>::dimensions <= details::max_rank)
+  DynArray& operator=(const E& e) {
+    const auto& shape = e.shape();
+    if (!std::equal(shape.begin(), shape.end(), shape_.begin(), shape_.end())) {
+      // 'e' may reference the current storage.
+      DynArray result(std::vector<std::size_t>(shape.begin(), shape.end()));
+      details::evaluateInto(result.data(), result.size(), e);
+      return *this = std::move(result);
+    }
+    details::evaluateInto(data(), size(), e);
+    return *this;
+  }
+
+  // Compiles f for every rank, and evaluates it for the rank of its operands.
+  template <class F, class... Args>
+  DynArray& operator=(const DynFunction<F, Args...>& f) {
+    details::dispatchRank(f.rank(), [&](auto rank) {
+      *this = f.template fixed<decltype(rank)::value>();
+    });
+    return *this;
+  }
+
+  DynArray& operator=(const T& value) {
+    std::fill(data(), data() + size(), value);
+    return *this;
+  }
+
+  void reshape(std::vector<std::size_t> shape) {
+    assert(!shape.empty() && shape.size() <= details::max_rank);
+    shape_ = std::move(shape);
+    data_.resize(size());
+  }
+
+  std::size_t rank() const noexcept {
+    return shape_.size();
+  }
+  const std::vector<std::size_t>& shape() const noexcept {
+    return shape_;
+  }
+  std::size_t size() const noexcept {
+    std::size_t result = 1;
+    for (auto n : shape_)
+      result *= n;
+    return shape_.empty() ? 0 : result;
+  }
+
+  T* data() noexcept {
+    return reinterpret_cast<T*>(data_.data());
+  }
+  const T* data() const noexcept {
+    return reinterpret_cast<const T*>(data_.data());
+  }
+
+  T& operator[](std::size_t i) noexcept {
+    return data()[i];
+  }
+  const T& operator[](std::size_t i) const noexcept {
+    return data()[i];
+  }
+
+  T& operator()(const std::vector<std::size_t>& idx) noexcept {
+    return data()[offset(idx)];
+  }
+  const T& operator()(const std::vector<std::size_t>& idx) const noexcept {
+    return data()[offset(idx)];
+  }
+
+  // View of the elements with the compile time rank N, which must be equal to rank().
+  template <std::size_t N>
+  NDView<T, N> view() noexcept {
+    const auto shape = fixedShape<N>();
+    return NDView<T, N>(data(), shape, details::contiguousStrides<N>(shape, layout::right));
+  }
+  template <std::size_t N>
+  NDView<const T, N> view() const noexcept {
+    const auto shape = fixedShape<N>();
+    return NDView<const T, N>(data(), shape, details::contiguousStrides<N>(shape, layout::right));
+  }
+  template <std::size_t N>
+  operator NDView<T, N>() noexcept {
+    return view<N>();
+  }
+  template <std::size_t N>
+  operator NDView<const T, N>() const noexcept {
+    return view<N>();
+  }
+
+  template <std::size_t N>
+  details::DenseView<T, N> dense() const noexcept {
+    return details::DenseView<T, N>(data(), fixedShape<N>());
+  }
+
+private:
+  template <std::size_t N>
+  std::array<std::size_t, N> fixedShape() const noexcept {
+    assert(rank() == N);
+    std::array<std::size_t, N> shape;
+    std::copy_n(shape_.begin(), N, shape.begin());
+    return shape;
+  }
+
+  std::size_t offset(const std::vector<std::size_t>& idx) const noexcept {
+    assert(idx.size() == rank());
+    std::size_t result = 0;
+    for (std::size_t d = 0; d < rank(); ++d) {
+      assert(idx[d] < shape_[d]);
+      result = result * shape_[d] + idx[d];
+    }
+    return result;
+  }
+
+  std::vector<std::size_t> shape_;
+  details::Storage<T> data_;
+};
+
+template <class F, class... Args>
+DynArray(const DynFunction<F, Args...>&) -> DynArray<typename DynFunction<F, Args...>::value_type>;
+
+// Lazy function of DynArrays of equal rank. Its operands are converted to fixed rank objects
+// only when the rank is dispatched.
+template <class F, class... Args>
+class DynFunction {
+public:
+  using value_type = std::decay_t<std::invoke_result_t<F, details::DynElement<Args>...>>;
+
+  DynFunction(F f, const Args&... args) : f_(std::move(f)), args_(args...) {}
+
+  // Common rank of the array operands. Throws std::invalid_argument if they differ.
+  std::size_t rank() const {
+    std::size_t result = 0;
+    for_each_in_tuple(args_, [&](const auto& arg) {
+      const std::size_t rank = details::rankOf(arg);
+      if (rank && result && rank != result)
+        throw(std::invalid_argument("Operands of different rank."));
+      result = std::max(result, rank);
+    });
+    return result;
+  }
+
+  // Expression of rank N on the same operands.
+  template <std::size_t N>
+  auto fixed() const {
+    return std::apply(
+        [&](const auto&... args) { return nd::apply(F(f_), details::fixedRank<N>(args)...); },
+        args_);
+  }
+
+private:
+  template <class A>
+  using Argument = std::conditional_t<details::is_dyn_array<A>, const A&, A>;
+
+  F f_;
+  std::tuple<Argument<Args>...> args_;
+};
+
+// Lazy function of DynArrays and scalars.
+template <class F, dyn_evaluated... Args> requires(details::is_dyn<Args> || ...)
+auto apply(F&& f, const Args&... args) {
+  return DynFunction<std::decay_t<F>, Args...>(std::forward<F>(f), args...);
+}
+
+template <dyn_evaluated L, dyn_evaluated R> requires(details::is_dyn<L> || details::is_dyn<R>)
+auto operator+(const L& l, const R& r) {
+  return nd::apply(std::plus<>(), l, r);
+}
+
+template <dyn_evaluated L, dyn_evaluated R> requires(details::is_dyn<L> || details::is_dyn<R>)
+auto operator-(const L& l, const R& r) {
+  return nd::apply(std::minus<>(), l, r);
+}
+
+template <dyn_evaluated L, dyn_evaluated R> requires(details::is_dyn<L> || details::is_dyn<R>)
+auto operator*(const L& l, const R& r) {
+  return nd::apply(std::multiplies<>(), l, r);
+}
+
+template <dyn_evaluated L, dyn_evaluated R> requires(details::is_dyn<L> || details::is_dyn<R>)
+auto operator/(const L& l, const R& r) {
+  return nd::apply(std::divides<>(), l, r);
+}
+
+namespace details {
+
+// Argument of rank N of the function called by nd::dispatch.
+template <std::size_t N, class A>
+decltype(auto) dispatchArgument(A&& a) {
+  using Arg = std::decay_t<A>;
+  if constexpr (is_dyn_array<Arg>)
+    return a.template view<N>();
+  else if constexpr (is_dyn_function<Arg>)
+    return a.template fixed<N>();
+  else
+    return std::forward<A>(a);
+}
+
+template <std::size_t N, class F, class... Args>
+auto dispatchFixed(F& f, Args&&... args) {
+  using Result = decltype(f(dispatchArgument<N>(std::forward<Args>(args))...));
+  if constexpr (nd_object<Result>)
+    return DynArray<ElementType<Result>>(f(dispatchArgument<N>(std::forward<Args>(args))...));
+  else
+    return f(dispatchArgument<N>(std::forward<Args>(args))...);
+}
+
+}  // namespace details
+
+// Calls f with the DynArray arguments converted to NDViews, and DynFunctions to expressions, of
+// their common rank. f is compiled for every rank and must return the same type for each, or an
+// nd object, which is evaluated into a DynArray. E.g.
+// double norm = nd::dispatch([](auto x) { return nd::sum(x * x); }, a);
+template <class F, class... Args>
+auto dispatch(F&& f, Args&&... args) {
+  std::size_t rank = 0;
+  auto check = [&](std::size_t r) {
+    if (r && rank && r != rank)
+      throw(std::invalid_argument("Operands of different rank."));
+    rank = std::max(rank, r);
+  };
+  (check(details::rankOf(args)), ...);
+
+  auto arguments = std::forward_as_tuple(std::forward<Args>(args)...);
+  return details::dispatchRank(rank, [&](auto n) {
+    return std::apply(
+        [&](auto&&... xs) {
+          return details::dispatchFixed<decltype(n)::value>(f, std::forward<decltype(xs)>(xs)...);
+        },
+        std::move(arguments));
+  });
+}
+
+}  // namespace nd
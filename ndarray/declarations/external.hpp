@@ -0,0 +1,56 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Views of memory owned by other libraries, and conversions to and from std::mdspan.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <version>
+
+#ifdef __cpp_lib_mdspan
+#include <mdspan>
+#endif
+
+#include "ndarray/declarations/layout.hpp"
+#include "ndarray/declarations/nd_view.hpp"
+
+namespace nd {
+
+// View of the contiguous external memory 'data', with the axes stored in 'order'. The memory is
+// not copied and must outlive the view.
+template <class T, std::size_t dims>
+NDView<T, dims> makeView(T* data, const std::array<std::size_t, dims>& shape,
+                         const std::type_identity_t<AxisOrder<dims>>& order = layout::right) {
+  return NDView<T, dims>(data, shape, details::contiguousStrides(shape, order));
+}
+
+#ifdef __cpp_lib_mdspan
+
+template <class T, std::size_t dims>
+auto toMdspan(const NDView<T, dims>& view) {
+  using Extents = std::dextents<std::size_t, dims>;
+  return std::mdspan<T, Extents, std::layout_stride>(
+      view.data(), std::layout_stride::mapping<Extents>(Extents(view.shape()), view.strides()));
+}
+
+// View of the elements of a strided mdspan with the default accessor.
+template <class T, class Extents, class Layout>
+requires(Layout::template mapping<Extents>::is_always_strided())
+auto makeView(const std::mdspan<T, Extents, Layout>& span) {
+  constexpr std::size_t dims = Extents::rank();
+  std::array<std::size_t, dims> shape, strides;
+  for (std::size_t r = 0; r < dims; ++r) {
+    shape[r] = span.extent(r);
+    strides[r] = span.stride(r);
+  }
+  return NDView<T, dims>(span.data_handle(), shape, strides);
+}
+
+#endif  // __cpp_lib_mdspan
+
+}  // namespace nd
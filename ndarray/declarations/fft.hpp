@@ -0,0 +1,371 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Mixed radix fast Fourier transforms along one axis of an array or view.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <concepts>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <vector>
+
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+template <class T, std::size_t dims>
+class NDView;
+template <class T, std::size_t dims>
+class NDArray;
+
+namespace details {
+
+// Approximate size in bytes of the fibres staged together by each thread.
+constexpr std::size_t fft_batch_bytes = 1 << 17;
+
+// Complex product without the checks for infinities of std::complex, which prevent vectorization.
+template <class T>
+inline std::complex<T> mul(const std::complex<T>& a, const std::complex<T>& b) noexcept {
+  return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// Precomputed factorization and roots of unity for transforms of a given length.
+template <std::floating_point T>
+class FFTPlan {
+public:
+  using Complex = std::complex<T>;
+
+  explicit FFTPlan(std::size_t n) : n_(n) {
+    // Radix 4 butterflies are the cheapest, then small primes. Large prime factors fall back
+    // to a quadratic DFT.
+    std::size_t rest = n;
+    while (rest % 4 == 0) {
+      factors_.push_back(4);
+      rest /= 4;
+    }
+    for (std::size_t p = 2; p * p <= rest; p += 1 + (p > 2)) {
+      while (rest % p == 0) {
+        factors_.push_back(p);
+        rest /= p;
+      }
+    }
+    if (rest > 1 || factors_.empty())
+      factors_.push_back(rest);
+
+    for (int direction = 0; direction < 2; ++direction) {
+      twiddles_[direction].resize(n);
+      const long double sign = direction ? 1 : -1;
+      for (std::size_t i = 0; i < n; ++i) {
+        const long double angle = sign * 2 * std::numbers::pi_v<long double> * i / n;
+        twiddles_[direction][i] = Complex(T(std::cos(angle)), T(std::sin(angle)));
+      }
+    }
+  }
+
+  // Returns the plan for length n, creating it on first use. Plans are shared between threads.
+  static std::shared_ptr<const FFTPlan> get(std::size_t n) {
+    static std::mutex mutex;
+    static std::map<std::size_t, std::shared_ptr<const FFTPlan>> cache;
+    std::unique_lock<std::mutex> lock(mutex);
+    auto& plan = cache[n];
+    if (!plan)
+      plan = std::make_shared<const FFTPlan>(n);
+    return plan;
+  }
+
+  std::size_t size() const noexcept {
+    return n_;
+  }
+
+  // Writes the unnormalized transform of in[0, n) into out[0, n), which must not overlap.
+  void execute(const Complex* in, Complex* out, bool inverse) const {
+    transform(in, 1, out, 0, n_, twiddles_[inverse].data(), inverse);
+  }
+
+private:
+  // Decimation in time: the p interleaved subsequences of 'in' are transformed into consecutive
+  // blocks of 'out', then combined by radix p butterflies. 'stride' is also n_ / n.
+  void transform(const Complex* in, std::size_t stride, Complex* out, std::size_t stage,
+                 std::size_t n, const Complex* tw, bool inverse) const {
+    const std::size_t p = factors_[stage];
+    const std::size_t m = n / p;
+    if (m == 1) {
+      for (std::size_t q = 0; q < p; ++q)
+        out[q] = in[q * stride];
+    }
+    else {
+      for (std::size_t q = 0; q < p; ++q)
+        transform(in + q * stride, stride * p, out + q * m, stage + 1, m, tw, inverse);
+    }
+
+    switch (p) {
+      case 2:
+        butterfly2(out, m, stride, tw);
+        break;
+      case 4:
+        butterfly4(out, m, stride, tw, inverse);
+        break;
+      default:
+        butterflyGeneric(out, m, p, stride, tw);
+    }
+  }
+
+  static void butterfly2(Complex* out, std::size_t m, std::size_t s, const Complex* tw) {
+    for (std::size_t k = 0; k < m; ++k) {
+      const Complex t = mul(out[k + m], tw[k * s]);
+      out[k + m] = out[k] - t;
+      out[k] += t;
+    }
+  }
+
+  static void butterfly4(Complex* out, std::size_t m, std::size_t s, const Complex* tw,
+                         bool inverse) {
+    // Multiplication by -i, or i for the inverse transform.
+    const T sign = inverse ? -1 : 1;
+    for (std::size_t k = 0; k < m; ++k) {
+      const Complex a0 = out[k];
+      const Complex a1 = mul(out[k + m], tw[k * s]);
+      const Complex a2 = mul(out[k + 2 * m], tw[2 * k * s]);
+      const Complex a3 = mul(out[k + 3 * m], tw[3 * k * s]);
+      const Complex b0 = a0 + a2, b1 = a0 - a2, b2 = a1 + a3;
+      const Complex d = a1 - a3;
+      const Complex b3(sign * d.imag(), -sign * d.real());
+      out[k] = b0 + b2;
+      out[k + m] = b1 + b3;
+      out[k + 2 * m] = b0 - b2;
+      out[k + 3 * m] = b1 - b3;
+    }
+  }
+
+  void butterflyGeneric(Complex* out, std::size_t m, std::size_t p, std::size_t s,
+                        const Complex* tw) const {
+    // The p-th roots of unity are every n_ / p twiddles.
+    const std::size_t root_stride = n_ / p;
+    std::vector<Complex> t(p);
+    for (std::size_t k = 0; k < m; ++k) {
+      for (std::size_t q = 0; q < p; ++q)
+        t[q] = mul(out[k + q * m], tw[q * k * s]);
+      for (std::size_t r = 0; r < p; ++r) {
+        Complex sum = t[0];
+        for (std::size_t q = 1, qr = r; q < p; ++q, qr = (qr + r) % p)
+          sum += mul(t[q], tw[qr * root_stride]);
+        out[k + r * m] = sum;
+      }
+    }
+  }
+
+  std::size_t n_;
+  std::vector<std::size_t> factors_;
+  std::array<std::vector<Complex>, 2> twiddles_;
+};
+
+// Offsets of the one dimensional fibres of a view along 'axis'. Consecutive fibres are
+// consecutive along the last of the other axes, so a batch of them is read by rows when the
+// transformed axis is not the last one.
+template <std::size_t dims>
+struct FibreLayout {
+  FibreLayout(const std::array<std::size_t, dims>& shape,
+              const std::array<std::size_t, dims>& strides, std::size_t axis)
+      : shape(shape), strides(strides), axis(axis) {
+    for (std::size_t d = 0; d < dims; ++d)
+      count *= d == axis ? 1 : shape[d];
+  }
+
+  long offset(std::size_t fibre) const noexcept {
+    long result = 0;
+    for (int d = int(dims) - 1; d >= 0; --d) {
+      if (std::size_t(d) == axis)
+        continue;
+      result += long(fibre % shape[d] * strides[d]);
+      fibre /= shape[d];
+    }
+    return result;
+  }
+
+  std::array<std::size_t, dims> shape;
+  std::array<std::size_t, dims> strides;
+  std::size_t axis;
+  std::size_t count = 1;
+};
+
+// Number of fibres of 'n' elements of type T staged together.
+template <class T>
+std::size_t fftBatchSize(std::size_t n) {
+  return std::clamp<std::size_t>(fft_batch_bytes / (n * sizeof(T)), 1, 64);
+}
+
+// Calls f(first_fibre, last_fibre, scratch) in parallel on batches of at most 'batch' fibres.
+template <class Scratch, class F>
+void forEachFibreBatch(std::size_t n_fibres, std::size_t batch, std::size_t fibre_size,
+                       std::size_t scratch_size, F&& f) {
+  const std::size_t n_batches = (n_fibres + batch - 1) / batch;
+  const std::size_t grain = std::max<std::size_t>(1, (1 << 15) / (batch * fibre_size));
+  parallelFor(0, n_batches, grain, [&](std::size_t begin, std::size_t end) {
+    Scratch scratch(scratch_size);
+    for (std::size_t id = begin; id < end; ++id)
+      f(id * batch, std::min(n_fibres, (id + 1) * batch), scratch);
+  });
+}
+
+template <class T, std::size_t dims>
+void fftAxis(const NDView<std::complex<T>, dims>& x, std::size_t axis, bool inverse) {
+  using Complex = std::complex<T>;
+  assert(axis < dims);
+  const std::size_t n = x.shape()[axis];
+  if (x.length() == 0 || n <= 1)
+    return;
+
+  const auto plan = FFTPlan<T>::get(n);
+  const FibreLayout<dims> fibres(x.shape(), x.strides(), axis);
+  const long stride = x.strides()[axis];
+  const T scale = inverse ? T(1) / T(n) : T(1);
+  Complex* const data = x.data();
+
+  // Contiguous fibres are transformed directly from the array.
+  const std::size_t batch = stride == 1 ? 1 : fftBatchSize<Complex>(n);
+
+  forEachFibreBatch<std::vector<Complex>>(
+      fibres.count, batch, n, 2 * batch * n,
+      [&](std::size_t first, std::size_t last, std::vector<Complex>& scratch) {
+        Complex* const staged = scratch.data();
+        Complex* const result = staged + batch * n;
+        const std::size_t size = last - first;
+        std::array<long, 64> offsets;
+        for (std::size_t b = 0; b < size; ++b)
+          offsets[b] = fibres.offset(first + b);
+
+        if (stride == 1) {
+          plan->execute(data + offsets[0], result, inverse);
+          Complex* const fibre = data + offsets[0];
+          for (std::size_t k = 0; k < n; ++k)
+            fibre[k] = result[k] * scale;
+          return;
+        }
+
+        for (std::size_t k = 0; k < n; ++k)
+          for (std::size_t b = 0; b < size; ++b)
+            staged[b * n + k] = data[offsets[b] + long(k) * stride];
+        for (std::size_t b = 0; b < size; ++b)
+          plan->execute(staged + b * n, result + b * n, inverse);
+        for (std::size_t k = 0; k < n; ++k)
+          for (std::size_t b = 0; b < size; ++b)
+            data[offsets[b] + long(k) * stride] = result[b * n + k] * scale;
+      });
+}
+
+}  // namespace details
+
+// Replaces each fibre of 'x' along 'axis' with its discrete Fourier transform
+// X_k = sum_j x_j exp(-2 pi i j k / n). Fibres are transformed in parallel; strided fibres are
+// staged in batches into contiguous buffers. The transform of a length with large prime factors
+// is slow.
+template <std::floating_point T, std::size_t dims>
+void fft(const NDView<std::complex<T>, dims>& x, std::size_t axis = dims - 1) {
+  details::fftAxis(x, axis, false);
+}
+
+template <std::floating_point T, std::size_t dims>
+void fft(NDArray<std::complex<T>, dims>& x, std::size_t axis = dims - 1) {
+  details::fftAxis(static_cast<NDView<std::complex<T>, dims>>(x), axis, false);
+}
+
+// Inverse of fft, including the normalization by 1 / n.
+template <std::floating_point T, std::size_t dims>
+void ifft(const NDView<std::complex<T>, dims>& x, std::size_t axis = dims - 1) {
+  details::fftAxis(x, axis, true);
+}
+
+template <std::floating_point T, std::size_t dims>
+void ifft(NDArray<std::complex<T>, dims>& x, std::size_t axis = dims - 1) {
+  details::fftAxis(static_cast<NDView<std::complex<T>, dims>>(x), axis, true);
+}
+
+// Returns the non negative frequencies of the transform of a real array along 'axis', which has
+// n / 2 + 1 elements in the result. Pairs of real fibres are transformed together as the real
+// and imaginary part of a single complex fibre.
+template <class T, std::size_t dims>
+requires std::floating_point<std::remove_const_t<T>>
+auto rfft(const NDView<T, dims>& x, std::size_t axis = dims - 1) {
+  using Real = std::remove_const_t<T>;
+  using Complex = std::complex<Real>;
+  assert(axis < dims);
+
+  const std::size_t n = x.shape()[axis];
+  const std::size_t n_out = n / 2 + 1;
+  auto shape = x.shape();
+  shape[axis] = n_out;
+  NDArray<Complex, dims> result(shape);
+  if (result.length() == 0)
+    return result;
+
+  const NDView<Complex, dims> out = result;
+  const details::FibreLayout<dims> in_fibres(x.shape(), x.strides(), axis);
+  const details::FibreLayout<dims> out_fibres(out.shape(), out.strides(), axis);
+  const long in_stride = x.strides()[axis];
+  const long out_stride = out.strides()[axis];
+  const auto plan = details::FFTPlan<Real>::get(n);
+  const T* const in_data = x.data();
+  Complex* const out_data = out.data();
+
+  // Batches contain an even number of fibres.
+  const std::size_t batch = 2 * std::max<std::size_t>(1, details::fftBatchSize<Complex>(n) / 2);
+
+  details::forEachFibreBatch<std::vector<Complex>>(
+      in_fibres.count, batch, n, batch * n,
+      [&](std::size_t first, std::size_t last, std::vector<Complex>& scratch) {
+        const std::size_t size = last - first;
+        const std::size_t pairs = (size + 1) / 2;
+        Complex* const staged = scratch.data();
+        Complex* const transformed = staged + pairs * n;
+        std::array<long, 64> in_offsets, out_offsets;
+        for (std::size_t b = 0; b < size; ++b) {
+          in_offsets[b] = in_fibres.offset(first + b);
+          out_offsets[b] = out_fibres.offset(first + b);
+        }
+
+        for (std::size_t k = 0; k < n; ++k)
+          for (std::size_t pair = 0; pair < pairs; ++pair) {
+            const std::size_t b = 2 * pair;
+            const Real re = in_data[in_offsets[b] + long(k) * in_stride];
+            const Real im = b + 1 < size ? in_data[in_offsets[b + 1] + long(k) * in_stride] : 0;
+            staged[pair * n + k] = Complex(re, im);
+          }
+        for (std::size_t pair = 0; pair < pairs; ++pair)
+          plan->execute(staged + pair * n, transformed + pair * n, false);
+
+        // With z = a + i b: A_k = (Z_k + conj(Z_{n-k})) / 2, B_k = (Z_k - conj(Z_{n-k})) / 2i.
+        for (std::size_t k = 0; k < n_out; ++k)
+          for (std::size_t pair = 0; pair < pairs; ++pair) {
+            const std::size_t b = 2 * pair;
+            const Complex z = transformed[pair * n + k];
+            const Complex z_conj = std::conj(transformed[pair * n + (n - k) % n]);
+            out_data[out_offsets[b] + long(k) * out_stride] = (z + z_conj) * Real(0.5);
+            if (b + 1 < size) {
+              const Complex diff = z - z_conj;
+              out_data[out_offsets[b + 1] + long(k) * out_stride] =
+                  Complex(diff.imag(), -diff.real()) * Real(0.5);
+            }
+          }
+      });
+
+  return result;
+}
+
+template <std::floating_point T, std::size_t dims>
+auto rfft(const NDArray<T, dims>& x, std::size_t axis = dims - 1) {
+  return rfft(static_cast<NDView<const T, dims>>(x), axis);
+}
+
+}  // namespace nd
@@ -0,0 +1,382 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// View selecting an arbitrary list of indices along one axis ("fancy" indexing).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+#include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/parallel.hpp"
+#include "ndarray/declarations/ranges.hpp"
+
+namespace nd {
+
+template <class T, std::size_t dims>
+class NDView;
+
+namespace details {
+template <class T>
+using IndexValue = std::remove_const_t<typename std::decay_t<T>::value_type>;
+}  // namespace details
+
+// One dimensional array or view of integers. Arrays of bool are masks instead.
+template <class T>
+concept index_array = nd_object<T> && std::decay_t<T>::dimensions == 1 &&
+                      requires { typename std::decay_t<T>::value_type; } &&
+                      std::is_integral_v<details::IndexValue<T>> &&
+                      !std::is_same_v<details::IndexValue<T>, bool>;
+
+template <class T>
+concept gather_specifier = axis_specifier<T> || index_array<T>;
+
+// Exactly one index array, mixed with the usual axis specifiers.
+template <std::size_t N, class... Args>
+constexpr bool is_gather_index = ((std::size_t(index_array<Args>) + ...) == 1) &&
+                                 (gather_specifier<Args> && ...);
+
+// Axis of the sliced view the index array applies to.
+template <class... Args>
+constexpr std::size_t gather_axis = [] {
+  constexpr bool is_index[] = {index_array<Args>...};
+  constexpr bool is_fixed[] = {std::is_integral_v<std::decay_t<Args>>...};
+  std::size_t axis = 0;
+  for (std::size_t i = 0; !is_index[i]; ++i)
+    axis += !is_fixed[i];
+  return axis;
+}();
+
+template <class T, std::size_t dims, std::integral I>
+class IndexedView {
+public:
+  constexpr static std::size_t dimensions = dims;
+  using value_type = T;
+
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = false;
+
+  // Number of consecutive indices processed before the accessed rows are prefetched.
+  constexpr static std::size_t prefetch_distance = 8;
+  // Minimum number of elements moved by each thread.
+  constexpr static std::size_t parallel_grain = 1 << 15;
+
+  IndexedView(const NDView<T, dims>& view, const NDView<const I, 1>& indices, std::size_t axis)
+      : view_(view), indices_(indices), axis_(axis), shape_(view.shape()) {
+    assert(axis < dims);
+    shape_[axis_] = indices_.length();
+  }
+
+  IndexedView(const IndexedView& rhs) = default;
+
+  // Scatter: assigns to the selected elements.
+  IndexedView& operator=(const std::remove_const_t<T>& value) {
+    forEachRow<true>(view_, 0, rows(), [&](T* row, const T* /*other*/) {
+      fillStrided(row, value, axis_ + 1);
+    });
+    return *this;
+  }
+
+  IndexedView& operator=(const IndexedView& rhs) {
+    return assign(rhs);
+  }
+
+  template <nd_object E>
+  IndexedView& operator=(const E& rhs) {
+    return assign(rhs);
+  }
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+
+  std::size_t length() const noexcept {
+    return std::accumulate(shape_.begin(), shape_.end(), 1ul, std::multiplies<std::size_t>());
+  }
+
+  const T& operator()(const std::array<std::size_t, dims>& idx) const noexcept {
+    return view_(mapIndex(idx));
+  }
+  T& operator()(const std::array<std::size_t, dims>& idx) noexcept {
+    return view_(mapIndex(idx));
+  }
+
+  template <class... Ints>
+  requires is_complete_index<dims, Ints...> const T& operator()(Ints... ns) const noexcept {
+    return (*this)(std::array<std::size_t, dims>{static_cast<std::size_t>(ns)...});
+  }
+  template <class... Ints>
+  requires is_complete_index<dims, Ints...> T& operator()(Ints... ns) noexcept {
+    return (*this)(std::array<std::size_t, dims>{static_cast<std::size_t>(ns)...});
+  }
+
+  // Access methods for broadcasting operations. Dimensions with size 1 or past the end are ignored.
+  template <std::size_t id_dim>
+  const T& extendedElement(const std::array<std::size_t, id_dim>& index) const noexcept {
+    return view_(mapIndex(shrinkIndex(index)));
+  }
+  template <std::size_t id_dim>
+  T& extendedElement(const std::array<std::size_t, id_dim>& index) noexcept {
+    return view_(mapIndex(shrinkIndex(index)));
+  }
+
+  // Gather: copies the selected elements into 'dest', which must have the same shape and must not
+  // overlap with the indexed data.
+  template <class U>
+  void gatherInto(NDView<U, dims>& dest) const {
+    assert(dest.shape() == shape_);
+    const std::size_t grain = std::max<std::size_t>(1, parallel_grain / std::max<std::size_t>(1, innerLength()));
+
+    parallelFor(0, rows(), grain, [&](std::size_t begin, std::size_t end) {
+      forEachRow<false>(dest, begin, end, [&](const T* row, U* out) {
+        copyInner(out, dest.strides_, row, view_.strides_);
+      });
+    });
+  }
+
+  // True if the indexed data shares memory with 'view'.
+  template <class U, std::size_t n>
+  bool overlaps(const NDView<U, n>& view) const noexcept {
+    const auto [first, last] = extent(view_);
+    const auto [view_first, view_last] = extent(view);
+    return first < view_last && view_first < last;
+  }
+
+private:
+  template <class E>
+  IndexedView& assign(const E& rhs) {
+    if constexpr (is_nd_array<E> || is_nd_view<E>) {
+      if constexpr (E::dimensions == dims) {
+        if (rhs.shape() == shape_) {
+          using U = std::remove_const_t<typename E::value_type>;
+          const NDView<const U, dims> other = rhs;
+          forEachRow<true>(other, 0, rows(), [&](T* row, const U* in) {
+            copyInner(row, view_.strides_, in, other.strides_);
+          });
+          return *this;
+        }
+      }
+    }
+    if constexpr (E::dimensions == dims) {
+      if (!getBroadcasted(rhs) && rhs.shape() == shape_) {
+        broadcastShape([&](const auto& idx) { (*this)(idx) = rhs(idx); }, shape_);
+        return *this;
+      }
+    }
+    broadcastShape([&](const auto& idx) { (*this)(idx) = rhs.extendedElement(idx); }, shape_);
+    return *this;
+  }
+
+  template <class U, std::size_t n>
+  static auto extent(const NDView<U, n>& view) noexcept {
+    std::size_t last = 1;
+    for (std::size_t i = 0; i < n; ++i)
+      last += (view.shape_[i] - 1) * view.strides_[i];
+    return std::make_pair(reinterpret_cast<std::uintptr_t>(view.data_),
+                          reinterpret_cast<std::uintptr_t>(view.data_ + last));
+  }
+
+  std::size_t rows() const noexcept {
+    std::size_t n = 1;
+    for (std::size_t i = 0; i <= axis_; ++i)
+      n *= shape_[i];
+    return n;
+  }
+
+  std::size_t innerLength() const noexcept {
+    std::size_t n = 1;
+    for (std::size_t i = axis_ + 1; i < dims; ++i)
+      n *= shape_[i];
+    return n;
+  }
+
+  std::size_t sourceIndex(std::size_t j) const noexcept {
+    const auto id = indices_(j);
+    const std::size_t source_id = details::getStart(id, view_.shape_[axis_]);
+    assert(source_id < view_.shape_[axis_]);
+    return source_id;
+  }
+
+  std::array<std::size_t, dims> mapIndex(std::array<std::size_t, dims> idx) const noexcept {
+    idx[axis_] = sourceIndex(idx[axis_]);
+    return idx;
+  }
+
+  template <std::size_t id_dim>
+  std::array<std::size_t, dims> shrinkIndex(const std::array<std::size_t, id_dim>& index) const noexcept {
+    static_assert(id_dim >= dims);
+    constexpr std::size_t dim_shift = id_dim - dims;
+    std::array<std::size_t, dims> idx;
+    for (std::size_t i = 0; i < dims; ++i)
+      idx[i] = shape_[i] > 1 ? index[i + dim_shift] : 0;
+    return idx;
+  }
+
+  // Calls f(indexed_row, other_row) on the rows [begin, end) of the flattened outer axes
+  // [0, axis_]. The rows of the indexed view are prefetched 'prefetch_distance' steps in advance.
+  template <bool write, class U, class F>
+  void forEachRow(const NDView<U, dims>& other, std::size_t begin, std::size_t end, F&& f) const {
+    if (begin >= end)
+      return;
+
+    const std::size_t n_idx = shape_[axis_];
+    const std::size_t stride = view_.strides_[axis_];
+    std::array<std::size_t, dims> outer;
+    std::size_t j = begin % n_idx;
+    std::size_t o = begin / n_idx;
+    for (int i = int(axis_) - 1; i >= 0; --i) {
+      outer[i] = o % shape_[i];
+      o /= shape_[i];
+    }
+
+    std::size_t view_base, other_base;
+    auto computeBases = [&] {
+      view_base = other_base = 0;
+      for (std::size_t i = 0; i < axis_; ++i) {
+        view_base += outer[i] * view_.strides_[i];
+        other_base += outer[i] * other.strides_[i];
+      }
+    };
+    computeBases();
+
+    for (std::size_t p = begin; p < end; ++p) {
+#if defined(__GNUC__)
+      if (j + prefetch_distance < n_idx)
+        __builtin_prefetch(view_.data_ + view_base + sourceIndex(j + prefetch_distance) * stride,
+                           write);
+#endif
+      f(view_.data_ + view_base + sourceIndex(j) * stride,
+        other.data_ + other_base + j * other.strides_[axis_]);
+
+      if (++j == n_idx && p + 1 < end) {
+        j = 0;
+        for (int i = int(axis_) - 1; i >= 0; --i) {
+          if (++outer[i] < shape_[i])
+            break;
+          outer[i] = 0;
+        }
+        computeBases();
+      }
+    }
+  }
+
+  // Copies the block spanned by the axes after axis_.
+  template <class T1, class T2>
+  void copyInner(T1* out, const std::array<std::size_t, dims>& out_strides, T2* in,
+                 const std::array<std::size_t, dims>& in_strides) const {
+    copyStrided(out, in, out_strides, in_strides, axis_ + 1);
+  }
+
+  template <class T1, class T2>
+  void copyStrided(T1* out, T2* in, const std::array<std::size_t, dims>& out_strides,
+                   const std::array<std::size_t, dims>& in_strides, std::size_t axis) const {
+    if (axis == dims) {
+      *out = *in;
+    }
+    else if (axis == dims - 1) {
+      const std::size_t n = shape_[axis];
+      const std::size_t so = out_strides[axis], si = in_strides[axis];
+      if (so == 1 && si == 1)
+        std::copy_n(in, n, out);
+      else
+        for (std::size_t i = 0; i < n; ++i)
+          out[i * so] = in[i * si];
+    }
+    else {
+      for (std::size_t i = 0; i < shape_[axis]; ++i)
+        copyStrided(out + i * out_strides[axis], in + i * in_strides[axis], out_strides, in_strides,
+                    axis + 1);
+    }
+  }
+
+  template <class V>
+  void fillStrided(T* out, const V& value, std::size_t axis) const {
+    if (axis == dims) {
+      *out = value;
+      return;
+    }
+    for (std::size_t i = 0; i < shape_[axis]; ++i)
+      fillStrided(out + i * view_.strides_[axis], value, axis + 1);
+  }
+
+  NDView<T, dims> view_;
+  NDView<const I, 1> indices_;
+  std::size_t axis_;
+  std::array<std::size_t, dims> shape_;
+};
+
+namespace details {
+
+template <index_array Idx>
+auto toIndexView(const Idx& indices) {
+  using I = std::remove_const_t<typename Idx::value_type>;
+  return static_cast<NDView<const I, 1>>(indices);
+}
+
+template <class Arg>
+const auto& indexToRange(const Arg& arg) {
+  if constexpr (index_array<Arg>)
+    return all;
+  else
+    return arg;
+}
+
+template <class Arg, class... Args>
+auto findIndexArray(const Arg& arg, const Args&... args) {
+  if constexpr (index_array<Arg>)
+    return toIndexView(arg);
+  else
+    return findIndexArray(args...);
+}
+
+// Slices 'view' with the index array replaced by the full range, then selects along that axis.
+template <class View, class... Args>
+auto gatherSlice(View& view, const Args&... args) {
+  auto slice = view(indexToRange(args)...);
+  auto indices = findIndexArray(args...);
+  using Slice = decltype(slice);
+  using I = std::remove_const_t<typename decltype(indices)::value_type>;
+  return IndexedView<typename Slice::value_type, Slice::dimensions, I>(slice, indices,
+                                                                       gather_axis<Args...>);
+}
+
+}  // namespace details
+
+// Lazy selection of 'indices' along 'axis'. Negative indices count from the end.
+template <class T, std::size_t dims, index_array Idx>
+auto take(const NDView<T, dims>& view, const Idx& indices, std::size_t axis = 0) {
+  auto index_view = details::toIndexView(indices);
+  using I = std::remove_const_t<typename decltype(index_view)::value_type>;
+  return IndexedView<T, dims, I>(view, index_view, axis);
+}
+
+template <class T, std::size_t dims, index_array Idx>
+auto take(NDArray<T, dims>& arr, const Idx& indices, std::size_t axis = 0) {
+  return take(static_cast<NDView<T, dims>>(arr), indices, axis);
+}
+
+template <class T, std::size_t dims, index_array Idx>
+auto take(const NDArray<T, dims>& arr, const Idx& indices, std::size_t axis = 0) {
+  return take(static_cast<NDView<const T, dims>>(arr), indices, axis);
+}
+
+// Scatters 'values' into the elements of 'arr' selected by 'indices' along 'axis'. With repeated
+// indices the last assigned value is kept.
+template <class A, index_array Idx, class V>
+void put(A&& arr, const Idx& indices, const V& values, std::size_t axis = 0) {
+  take(arr, indices, axis) = values;
+}
+
+}  // namespace nd
@@ -9,10 +9,12 @@
 
 #pragma once
 
+#include <concepts>
+#include <cstdint>
 #include <type_traits>
-#include <random>
 
 #include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/random.hpp"
 
 namespace nd {
 
@@ -30,27 +32,36 @@ auto ones(Is... shape) {
   return arr;
 }
 
-std::mt19937_64 __rng;
+// Seeds the engine used by the random initialization functions. The values of an array depend
+// only on the seed and on the number of values drawn since, not on the number of threads.
+inline void seed(std::uint64_t s) {
+  RandomEngine::global().seed(s);
+}
 
-void seed(std::size_t s) {
-  __rng.seed(s);
+// Returns an array filled with values drawn from 'distribution'. E.g. random(Normal<double>{1, 2}, n).
+template <class Distribution, std::integral... Is>
+auto random(const Distribution& distribution, Is... shape) {
+  nd::NDArray<typename Distribution::value_type, sizeof...(Is)> arr(shape...);
+  RandomEngine::global().fill(arr, distribution);
+  return arr;
 }
 
+// Uniform in [0, 1).
 template <std::floating_point T, std::integral... Is>
 auto rand(Is... shape) {
-  std::uniform_real_distribution<T> distro(0, 1.);
-  nd::NDArray<T, sizeof...(Is)> arr(shape...);
-  for (auto& x : arr)
-    x = distro(__rng);
-  return arr;
+  return random(Uniform<T>{}, shape...);
 }
 
+// Uniformly distributed bits.
 template <std::integral T, std::integral... Is>
 auto rand(Is... shape) {
-  nd::NDArray<T, sizeof...(Is)> arr(shape...);
-  for (auto& x : arr)
-    x = __rng();
-  return arr;
+  return random(RandomBits<T>{}, shape...);
+}
+
+// Standard normal distribution.
+template <std::floating_point T, std::integral... Is>
+auto randn(Is... shape) {
+  return random(Normal<T>{}, shape...);
 }
 
 }  // namespace nd
@@ -0,0 +1,83 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Order of the axes of an array in memory.
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+namespace nd {
+
+// Axes from the slowest to the fastest varying in memory. E.g. {0, 1, 2} is row major and
+// {2, 1, 0} column major.
+template <std::size_t dims>
+using AxisOrder = std::array<std::size_t, dims>;
+
+namespace layout {
+
+// Row major (C) order: the last index is contiguous.
+struct Right {
+  template <std::size_t dims>
+  constexpr operator AxisOrder<dims>() const noexcept {
+    AxisOrder<dims> order{};
+    for (std::size_t d = 0; d < dims; ++d)
+      order[d] = d;
+    return order;
+  }
+};
+
+// Column major (Fortran) order: the first index is contiguous.
+struct Left {
+  template <std::size_t dims>
+  constexpr operator AxisOrder<dims>() const noexcept {
+    AxisOrder<dims> order{};
+    for (std::size_t d = 0; d < dims; ++d)
+      order[d] = dims - 1 - d;
+    return order;
+  }
+};
+
+inline constexpr Right right;
+inline constexpr Left left;
+
+}  // namespace layout
+
+namespace details {
+
+template <std::size_t dims>
+constexpr bool isRowMajor(const AxisOrder<dims>& order) noexcept {
+  return order == AxisOrder<dims>(layout::right);
+}
+
+template <std::size_t dims>
+bool isPermutation(const AxisOrder<dims>& order) noexcept {
+  std::array<bool, dims> seen{};
+  for (auto axis : order) {
+    if (axis >= dims || seen[axis])
+      return false;
+    seen[axis] = true;
+  }
+  return true;
+}
+
+// Strides of a contiguous array of 'shape' with its axes stored in 'order'.
+template <std::size_t dims>
+std::array<std::size_t, dims> contiguousStrides(const std::array<std::size_t, dims>& shape,
+                                                const AxisOrder<dims>& order) noexcept {
+  assert(isPermutation(order));
+  std::array<std::size_t, dims> strides;
+  std::size_t stride = 1;
+  for (int i = int(dims) - 1; i >= 0; --i) {
+    strides[order[i]] = stride;
+    stride *= shape[order[i]];
+  }
+  return strides;
+}
+
+}  // namespace details
+}  // namespace nd
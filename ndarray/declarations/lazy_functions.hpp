@@ -11,10 +11,13 @@
 
 #include <array>
 #include <cmath>
+#include <functional>
+#include <type_traits>
 #include <vector>
 #include <tuple>
 
 #include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/layout.hpp"
 
 namespace nd {
 
@@ -36,6 +39,13 @@ constexpr bool is_nd_array = false;
 template<class T, std::size_t dims>
 constexpr bool is_nd_array<NDArray<T, dims>> = true;
 
+template<class T, std::size_t dims>
+class NDView;
+template<class T>
+constexpr bool is_nd_view = false;
+template<class T, std::size_t dims>
+constexpr bool is_nd_view<NDView<T, dims>> = true;
+
 template <class T>
 constexpr auto getShape(const T& t) {
   return std::array<std::size_t, 0>{};
@@ -52,7 +62,7 @@ constexpr auto getBroadcasted(const T& t) {
 }
 
 template <class T>
-requires requires { T().broadcasted(); }
+requires requires(const T& t) { t.broadcasted(); }
 constexpr auto getBroadcasted(const T& t) {
   return t.broadcasted();
 }
@@ -63,6 +73,13 @@ constexpr std::size_t get_dimensions = 1;
 template <nd_object T>
 constexpr std::size_t get_dimensions<T> = T::dimensions;
 
+// Copy views and scalars by value, NDArrays and other owners of large storage by const reference.
+template <class T>
+constexpr bool is_referenced_argument = is_nd_array<T>;
+
+template <class T>
+using LazyArgument = std::conditional_t<is_referenced_argument<T>, const T&, T>;
+
 template <typename... Ts, typename F>
 void for_each_in_tuple(const std::tuple<Ts...>& t, F&& f) {
   auto for_each = []<std::size_t... Is>(auto&& t, auto&& f, std::index_sequence<Is...>) {
@@ -81,9 +98,23 @@ public:
 
   LazyFunction(F&& f, const Args&... args) : f_(f), args_(args...) {
     shape_.fill(0);
+    order_ = layout::right;
 
+    bool ordered = false;
     for_each_in_tuple(args_, [&](const auto& arg) {
-      broadcasted_ |= getBroadcasted(args_) || combineShapes(shape_, getShape(arg));
+      broadcasted_ |= combineShapes(shape_, getShape(arg)) || getBroadcasted(arg);
+
+      using Arg = std::decay_t<decltype(arg)>;
+      if constexpr (contiguous_nd_storage<Arg> && !std::is_scalar_v<Arg>) {
+        if constexpr (Arg::dimensions == dimensions) {
+          if constexpr (requires { arg.mixedOrder(); })
+            mixed_order_ |= arg.mixedOrder();
+          if (!ordered)
+            order_ = arg.order();
+          mixed_order_ |= arg.order() != order_;
+          ordered = true;
+        }
+      }
     });
   }
 
@@ -91,6 +122,14 @@ public:
     return broadcasted_;
   }
 
+  // Axis order of the first array operand, and whether the array operands have different orders.
+  const AxisOrder<dimensions>& order() const noexcept {
+    return order_;
+  }
+  bool mixedOrder() const noexcept {
+    return mixed_order_;
+  }
+
   auto operator()(const std::array<std::size_t, dimensions>& idx) const {
     return invokeHelper(idx, std::make_index_sequence<sizeof...(Args)>{});
   }
@@ -109,6 +148,14 @@ public:
     return shape_;
   }
 
+  // Function and arguments of the expression, used to rewrite it.
+  const F& function() const noexcept {
+    return f_;
+  }
+  const auto& arguments() const noexcept {
+    return args_;
+  }
+
 private:
   template <class Index, std::size_t... I>
   auto invokeHelper(const Index& idx, std::index_sequence<I...>) const {
@@ -127,7 +174,10 @@ private:
 
   template <nd_object T, class Index>
   auto evaluate(const T& x, const Index& idx) const {
-    return x(idx);
+    if constexpr (T::dimensions == std::tuple_size_v<Index>)
+      return x(idx);
+    else  // Operand of lower dimension.
+      return x.extendedElement(idx);
   }
 
   template <nd_object T, class Index>
@@ -147,60 +197,376 @@ private:
     return x;
   }
 
-  // Copy views and scalars by value, NDArrays by const reference.
-  template<class T>
-  using LazyArgument = std::conditional_t<is_nd_array<T>, const T&, T>;
-
   const F f_;
   using Tuple = std::tuple<LazyArgument<Args>...>;
   const Tuple args_;
   std::array<std::size_t, dimensions> shape_;
+  AxisOrder<dimensions> order_;
   bool broadcasted_ = false;
+  bool mixed_order_ = false;
 };
 
+namespace details {
+
+// True if the elements of 'x' are stored with the axes in 'order'.
+template <class E, std::size_t dims>
+bool hasOrder(const E& x, const AxisOrder<dims>& order) {
+  if constexpr (std::is_scalar_v<E>)
+    return true;
+  else if constexpr (requires { x.mixedOrder(); })
+    return !x.mixedOrder() && x.order() == order;
+  else
+    return x.order() == order;
+}
+
+// True if 'x' can be accessed through operator[] with the position in memory of an element of an
+// array of 'shape' with the axes in 'order'.
+template <class E, std::size_t dims>
+bool isLinear(const E& x, const std::array<std::size_t, dims>& shape,
+              const AxisOrder<dims>& order = layout::right) {
+  if constexpr (std::is_scalar_v<E>)
+    return true;
+  else if constexpr (contiguous_nd_storage<E> && E::dimensions == dims)
+    return !getBroadcasted(x) && x.shape() == shape && hasOrder(x, order);
+  else
+    return false;
+}
+
+// True if 'x' must be accessed through extendedElement to be evaluated over 'shape'.
+template <class E, std::size_t dims>
+bool isExtended(const E& x, const std::array<std::size_t, dims>& shape) {
+  if constexpr (std::is_scalar_v<E>)
+    return false;
+  else if constexpr (E::dimensions == dims)
+    return getBroadcasted(x) || x.shape() != shape;
+  else
+    return true;
+}
+
+template <class E>
+auto elementAt(const E& x, std::size_t i) {
+  if constexpr (std::is_scalar_v<E>)
+    return x;
+  else
+    return x[i];
+}
+
+template <class E, std::size_t dims>
+auto elementAt(const E& x, const std::array<std::size_t, dims>& index, bool extended) {
+  if constexpr (std::is_scalar_v<E>)
+    return x;
+  else if constexpr (E::dimensions != dims)
+    return x.extendedElement(index);
+  else
+    return extended ? x.extendedElement(index) : x(index);
+}
+
+}  // namespace details
+
+namespace details {
+
+// True if F applied to scalars only returns a scalar.
+template <class F, class... Args>
+constexpr bool is_foldable() {
+  if constexpr (sizeof...(Args) > 0 && (std::is_scalar_v<Args> && ...))
+    return std::is_scalar_v<std::invoke_result_t<F, const Args&...>>;
+  else
+    return false;
+}
+
+}  // namespace details
+
+// Functions of scalars only are evaluated immediately.
 template <class F, lazy_evaluated... Args>
 auto apply(F&& f, const Args&... args) {
-  return nd::LazyFunction<F, Args...>(std::forward<F>(f), args...);
+  if constexpr (details::is_foldable<F, Args...>())
+    return std::forward<F>(f)(args...);
+  else
+    return nd::LazyFunction<F, Args...>(std::forward<F>(f), args...);
+}
+
+namespace details {
+
+template <class T>
+constexpr bool is_lazy_function = false;
+template <class F, class... Args>
+constexpr bool is_lazy_function<LazyFunction<F, Args...>> = true;
+
+// Element type of the nd object E.
+template <nd_object E>
+using ElementType = std::decay_t<decltype(std::declval<const E&>()(
+    std::array<std::size_t, std::decay_t<E>::dimensions>{}))>;
+
+template <class T>
+constexpr bool is_convertible_number = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+// Applies F and converts its result to T, unless it is a boolean.
+template <class T, class F>
+struct ConvertResult {
+  template <class... Args>
+  auto operator()(const Args&... args) const {
+    using Result = std::decay_t<decltype(f(args...))>;
+    if constexpr (is_convertible_number<Result>)
+      return T(f(args...));
+    else
+      return f(args...);
+  }
+
+  F f;
+};
+
+template <class T>
+struct Convert {
+  template <class A>
+  T operator()(const A& a) const {
+    return T(a);
+  }
+};
+
+// Leaves of an expression converted to T. Arrays are still referenced, not copied.
+template <class T, class E>
+decltype(auto) convertLeaf(const E& e) {
+  if constexpr (std::is_scalar_v<E>) {
+    if constexpr (is_convertible_number<E>)
+      return T(e);
+    else
+      return e;
+  }
+  else if constexpr (is_convertible_number<ElementType<E>> && !std::is_same_v<ElementType<E>, T>)
+    return nd::apply(Convert<T>(), e);
+  else
+    return e;
+}
+
+}  // namespace details
+
+// Pins the compute type of an expression to T: scalars and the elements of arrays of a different
+// type are converted to T, and so is the result of each operation. Boolean values, such as the
+// result of comparisons, are left untouched. E.g. with 'B' an array of floats, 2. * B is evaluated
+// in double precision, while nd::as<float>(2. * B) is evaluated in single precision.
+template <class T, lazy_evaluated E>
+decltype(auto) as(const E& e) {
+  if constexpr (details::is_lazy_function<E>) {
+    using F = std::decay_t<decltype(e.function())>;
+    return std::apply(
+        [&](const auto&... args) {
+          return nd::apply(details::ConvertResult<T, F>{e.function()}, as<T>(args)...);
+        },
+        e.arguments());
+  }
+  else
+    return details::convertLeaf<T>(e);
+}
+
+// The arithmetic operators rewrite the expression trees at compile time: multiply-add patterns
+// are fused, and with NDARRAY_FAST_MATH scalar factors and terms are reassociated and folded, and
+// divisions by a scalar become multiplications by its reciprocal, at the cost of reduced precision.
+namespace details {
+
+#ifdef NDARRAY_FAST_MATH
+constexpr bool fast_math_enabled = true;
+#else
+constexpr bool fast_math_enabled = false;
+#endif
+
+// True if std::fma is implemented in hardware for T.
+template <class T>
+constexpr bool fast_fma = false;
+#ifdef FP_FAST_FMAF
+template <>
+constexpr bool fast_fma<float> = true;
+#endif
+#ifdef FP_FAST_FMA
+template <>
+constexpr bool fast_fma<double> = true;
+#endif
+#ifdef FP_FAST_FMAL
+template <>
+constexpr bool fast_fma<long double> = true;
+#endif
+
+// a * b + c, with a single rounding if fused multiply-add is supported by the hardware.
+struct MultiplyAdd {
+  template <class A, class B, class C>
+  auto operator()(const A& a, const B& b, const C& c) const {
+    using Result = decltype(a * b + c);
+    if constexpr (fast_fma<Result>)
+      return std::fma(Result(a), Result(b), Result(c));
+    else
+      return a * b + c;
+  }
+};
+
+// a * b - c.
+struct MultiplySubtract {
+  template <class A, class B, class C>
+  auto operator()(const A& a, const B& b, const C& c) const {
+    using Result = decltype(a * b - c);
+    if constexpr (fast_fma<Result>)
+      return std::fma(Result(a), Result(b), -Result(c));
+    else
+      return a * b - c;
+  }
+};
+
+// c - a * b.
+struct NegativeMultiplyAdd {
+  template <class A, class B, class C>
+  auto operator()(const A& a, const B& b, const C& c) const {
+    using Result = decltype(c - a * b);
+    if constexpr (fast_fma<Result>)
+      return std::fma(-Result(a), Result(b), Result(c));
+    else
+      return c - a * b;
+  }
+};
+
+// True if E applies the functor F to two arguments.
+template <class E, class F>
+constexpr bool is_binary = false;
+template <class F, class A, class B>
+constexpr bool is_binary<LazyFunction<F, A, B>, F> = true;
+
+// True if E applies the functor F to a scalar and to an nd object, in any order.
+template <class E, class F>
+constexpr bool is_scaled = false;
+template <class F, class A, class B>
+constexpr bool is_scaled<LazyFunction<F, A, B>, F> = std::is_scalar_v<A> != std::is_scalar_v<B>;
+
+template <std::size_t i, class E>
+const auto& argument(const E& e) {
+  return std::get<i>(e.arguments());
 }
 
+template <class E>
+const auto& scalarArgument(const E& e) {
+  using Args = std::decay_t<decltype(e.arguments())>;
+  return std::get<std::is_scalar_v<std::tuple_element_t<0, Args>> ? 0 : 1>(e.arguments());
+}
+
+template <class E>
+const auto& objectArgument(const E& e) {
+  using Args = std::decay_t<decltype(e.arguments())>;
+  return std::get<std::is_scalar_v<std::tuple_element_t<0, Args>> ? 1 : 0>(e.arguments());
+}
+
+}  // namespace details
+
 template <lazy_evaluated L, lazy_evaluated R>
 auto operator+(const L& l, const R& r) {
-  return apply(std::plus<>(), l, r);
+  using details::argument;
+  if constexpr (details::fast_math_enabled && details::is_scaled<L, std::plus<>> &&
+                std::is_scalar_v<R>)
+    return apply(std::plus<>(), details::objectArgument(l), details::scalarArgument(l) + r);
+  else if constexpr (details::fast_math_enabled && details::is_scaled<R, std::plus<>> &&
+                     std::is_scalar_v<L>)
+    return apply(std::plus<>(), details::objectArgument(r), l + details::scalarArgument(r));
+  else if constexpr (details::is_binary<L, std::multiplies<>>)
+    return apply(details::MultiplyAdd(), argument<0>(l), argument<1>(l), r);
+  else if constexpr (details::is_binary<R, std::multiplies<>>)
+    return apply(details::MultiplyAdd(), argument<0>(r), argument<1>(r), l);
+  else
+    return apply(std::plus<>(), l, r);
 }
 
 template <lazy_evaluated L, lazy_evaluated R>
 auto operator-(const L& l, const R& r) {
-  return apply(std::minus<>(), l, r);
+  using details::argument;
+  if constexpr (details::is_binary<L, std::multiplies<>>)
+    return apply(details::MultiplySubtract(), argument<0>(l), argument<1>(l), r);
+  else if constexpr (details::is_binary<R, std::multiplies<>>)
+    return apply(details::NegativeMultiplyAdd(), argument<0>(r), argument<1>(r), l);
+  else
+    return apply(std::minus<>(), l, r);
 }
 
 template <lazy_evaluated L, lazy_evaluated R>
 auto operator*(const L& l, const R& r) {
-  return apply(std::multiplies<>(), l, r);
+  if constexpr (details::fast_math_enabled && details::is_scaled<L, std::multiplies<>> &&
+                std::is_scalar_v<R>)
+    return apply(std::multiplies<>(), details::objectArgument(l), details::scalarArgument(l) * r);
+  else if constexpr (details::fast_math_enabled && details::is_scaled<R, std::multiplies<>> &&
+                     std::is_scalar_v<L>)
+    return apply(std::multiplies<>(), l * details::scalarArgument(r), details::objectArgument(r));
+  else
+    return apply(std::multiplies<>(), l, r);
 }
 
 template <lazy_evaluated L, lazy_evaluated R>
 auto operator/(const L& l, const R& r) {
-  return apply(std::divides<>(), l, r);
+  if constexpr (details::fast_math_enabled && std::is_floating_point_v<R>)
+    return l * (R(1) / r);
+  else if constexpr (details::fast_math_enabled && details::is_scaled<R, std::multiplies<>>) {
+    using S = std::decay_t<decltype(details::scalarArgument(r))>;
+    if constexpr (std::is_floating_point_v<S>)
+      return (l / details::objectArgument(r)) * (S(1) / details::scalarArgument(r));
+    else
+      return apply(std::divides<>(), l, r);
+  }
+  else
+    return apply(std::divides<>(), l, r);
 }
 
-template <lazy_evaluated L>
-auto sqrt(const L& l) {
-  return apply([](const auto& a) { return std::sqrt(a); }, l);
+// Comparisons return lazily evaluated boolean masks.
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator<(const L& l, const R& r) {
+  return apply(std::less<>(), l, r);
+}
+
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator<=(const L& l, const R& r) {
+  return apply(std::less_equal<>(), l, r);
+}
+
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator>(const L& l, const R& r) {
+  return apply(std::greater<>(), l, r);
+}
+
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator>=(const L& l, const R& r) {
+  return apply(std::greater_equal<>(), l, r);
 }
 
-template <lazy_evaluated L, class E>
-requires std::is_scalar_v<E> auto pow(const L& l, E exponent) {
-  return apply([exponent](const auto& a) { return std::pow(a, exponent); }, l);
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator==(const L& l, const R& r) {
+  return apply(std::equal_to<>(), l, r);
 }
 
-template <lazy_evaluated L, class E>
-requires std::is_scalar_v<E> auto exp(const L& l) {
-  return apply([](const auto& a) { return std::exp(a); }, l);
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator!=(const L& l, const R& r) {
+  return apply(std::not_equal_to<>(), l, r);
 }
 
-template <lazy_evaluated L, class E>
-requires std::is_scalar_v<E> auto log(const L& l) {
-  return apply([](const auto& a) { return std::log(a); }, l);
+// Element-wise combination of masks. Like numpy, '&' and '|' are bitwise on integers.
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator&(const L& l, const R& r) {
+  return apply(std::bit_and<>(), l, r);
+}
+
+template <lazy_evaluated L, lazy_evaluated R>
+auto operator|(const L& l, const R& r) {
+  return apply(std::bit_or<>(), l, r);
+}
+
+template <nd_object L>
+auto operator!(const L& l) {
+  return nd::apply(std::logical_not<>(), l);
+}
+
+// Selects element-wise between 'a' and 'b'. Both branches are evaluated, so that the selection
+// compiles to a conditional move or blend instead of a jump.
+struct Select {
+  template <class A, class B>
+  auto operator()(bool cond, const A& a, const B& b) const {
+    using Result = std::common_type_t<A, B>;
+    return cond ? Result(a) : Result(b);
+  }
+};
+
+template <lazy_evaluated C, lazy_evaluated A, lazy_evaluated B>
+auto where(const C& cond, const A& a, const B& b) {
+  return apply(Select(), cond, a, b);
 }
 
 }  // namespace nd
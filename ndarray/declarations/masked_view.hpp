@@ -0,0 +1,195 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Selection of the elements of an array or view through a boolean mask.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+#include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+template <class T, std::size_t dims>
+class NDView;
+
+// Array, view or lazy function of booleans with 'dims' dimensions.
+template <class M, std::size_t dims>
+concept mask_for = nd_object<M> && std::decay_t<M>::dimensions == dims &&
+                   std::is_same_v<std::decay_t<decltype(std::declval<const std::decay_t<M>&>()(
+                                      std::declval<const std::array<std::size_t, dims>&>()))>,
+                                  bool>;
+
+namespace details {
+template <class E>
+constexpr bool linear_access = std::is_scalar_v<E> || contiguous_nd_storage<E>;
+}  // namespace details
+
+// Assigns to the elements of a view where the mask is true. E.g. arr(arr > 1) = 1.
+template <class T, std::size_t dims, class Mask>
+class MaskedView {
+public:
+  // Minimum number of elements processed by each thread.
+  constexpr static std::size_t parallel_grain = 1 << 15;
+
+  MaskedView(const NDView<T, dims>& view, const Mask& mask) : view_(view), mask_(mask) {
+    assert(view_.shape() == mask_.shape());
+  }
+
+  MaskedView& operator=(const std::remove_const_t<T>& value) {
+    return assign(value);
+  }
+
+  // 'rhs' is evaluated at the position of each selected element, and must have a shape
+  // broadcastable to the view.
+  template <nd_object E>
+  MaskedView& operator=(const E& rhs) {
+    return assign(rhs);
+  }
+
+  // Number of selected elements.
+  std::size_t count() const {
+    std::size_t n = 0;
+    const bool extended = details::isExtended(mask_, view_.shape());
+    broadcastShape([&](const auto& index) { n += details::elementAt(mask_, index, extended); },
+                   view_.shape());
+    return n;
+  }
+
+private:
+  // The selection is branch free: unselected elements are assigned their own value.
+  template <class E>
+  MaskedView& assign(const E& rhs) {
+    const auto& shape = view_.shape();
+    const std::size_t n = view_.length();
+
+    if constexpr (details::linear_access<Mask> && details::linear_access<E>) {
+      if (view_.isContiguous() && details::isLinear(mask_, shape) && details::isLinear(rhs, shape)) {
+        T* const data = view_.data_;
+        parallelFor(0, n, parallel_grain, [&](std::size_t begin, std::size_t end) {
+          for (std::size_t i = begin; i < end; ++i) {
+            const T old = data[i];
+            const T val = static_cast<T>(details::elementAt(rhs, i));
+            data[i] = details::elementAt(mask_, i) ? val : old;
+          }
+        });
+        return *this;
+      }
+    }
+
+    const bool mask_extended = details::isExtended(mask_, shape);
+    const bool rhs_extended = details::isExtended(rhs, shape);
+    parallelFor(0, n, parallel_grain, [&](std::size_t begin, std::size_t end) {
+      broadcastShapeRange(
+          [&](const auto& index) {
+            T& x = view_(index);
+            x = details::elementAt(mask_, index, mask_extended)
+                    ? static_cast<T>(details::elementAt(rhs, index, rhs_extended))
+                    : x;
+          },
+          shape, begin, end);
+    });
+    return *this;
+  }
+
+  NDView<T, dims> view_;
+  LazyArgument<Mask> mask_;
+};
+
+// Returns a one dimensional array with the elements of 'arr' where 'mask' is true, in row major
+// order. The array is compacted in parallel: each thread counts the selected elements of a
+// contiguous chunk, then an exclusive scan over the counts gives the output offset of each chunk.
+template <class M, nd_object A>
+requires mask_for<M, std::decay_t<A>::dimensions>
+auto compress(const M& mask, const A& arr) {
+  constexpr std::size_t dims = A::dimensions;
+  constexpr std::size_t chunk_size = 1 << 15;
+  using Val = std::decay_t<decltype(arr(std::array<std::size_t, dims>{}))>;
+
+  const auto& shape = arr.shape();
+  assert(mask.shape() == shape);
+  const std::size_t n =
+      std::accumulate(shape.begin(), shape.end(), 1ul, std::multiplies<std::size_t>());
+  const std::size_t n_chunks =
+      std::max<std::size_t>(1, std::min(getNumThreads(), (n + chunk_size - 1) / chunk_size));
+  auto chunkBegin = [&](std::size_t chunk) { return (n * chunk) / n_chunks; };
+
+  bool linear = false;
+  if constexpr (details::linear_access<M> && details::linear_access<A>)
+    linear = details::isLinear(mask, shape) && details::isLinear(arr, shape);
+  const bool mask_extended = details::isExtended(mask, shape);
+  const bool arr_extended = details::isExtended(arr, shape);
+
+  // Calls f(selected, linear_index) or, if 'read_arr' is true, f(selected, arr_value) on the
+  // elements of [begin, end).
+  auto forEach = [&](std::size_t begin, std::size_t end, auto read_arr, auto&& f) {
+    auto call = [&](bool selected, std::size_t i, const auto& x) {
+      if constexpr (decltype(read_arr)::value)
+        f(selected, x());
+      else
+        f(selected, i);
+    };
+    if constexpr (details::linear_access<M> && details::linear_access<A>) {
+      if (linear) {
+        for (std::size_t i = begin; i < end; ++i)
+          call(details::elementAt(mask, i), i, [&] { return details::elementAt(arr, i); });
+        return;
+      }
+    }
+    std::size_t i = begin;
+    broadcastShapeRange(
+        [&](const auto& index) {
+          call(details::elementAt(mask, index, mask_extended), i++,
+               [&] { return details::elementAt(arr, index, arr_extended); });
+        },
+        shape, begin, end);
+  };
+
+  // Count the selected elements of each chunk, and the end of the last one.
+  std::vector<std::size_t> offsets(n_chunks + 1, 0);
+  std::vector<std::size_t> ends(n_chunks);
+  parallelFor(0, n_chunks, 1, [&](std::size_t chunk_start, std::size_t chunk_end) {
+    for (std::size_t chunk = chunk_start; chunk < chunk_end; ++chunk) {
+      std::size_t count = 0;
+      std::size_t last = chunkBegin(chunk);
+      forEach(chunkBegin(chunk), chunkBegin(chunk + 1), std::false_type(),
+              [&](bool selected, std::size_t i) {
+                count += selected;
+                last = selected ? i + 1 : last;
+              });
+      offsets[chunk + 1] = count;
+      ends[chunk] = last;
+    }
+  });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  // Branch free compaction: each element is written, but the output only advances past the
+  // selected ones. Stopping at the last selected element keeps the writes inside the chunk.
+  NDArray<Val, 1> result(offsets.back());
+  Val* const out = result.data();
+  parallelFor(0, n_chunks, 1, [&](std::size_t chunk_start, std::size_t chunk_end) {
+    for (std::size_t chunk = chunk_start; chunk < chunk_end; ++chunk) {
+      Val* pos = out + offsets[chunk];
+      forEach(chunkBegin(chunk), ends[chunk], std::true_type(), [&](bool selected, const Val& x) {
+        *pos = x;
+        pos += selected;
+      });
+    }
+  });
+
+  return result;
+}
+
+}  // namespace nd
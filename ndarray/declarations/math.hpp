@@ -0,0 +1,487 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Elementary functions of lazy expressions. With Precision::fast, transcendental functions are
+// evaluated with branch free polynomial approximations, which are inlined and vectorized by the
+// compiler in the evaluation loops, instead of calls to the scalar functions of the C library.
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "ndarray/declarations/lazy_functions.hpp"
+
+// The approximations must be inlined in the evaluation loops to be vectorized.
+#if defined(__GNUC__)
+#define NDARRAY_ALWAYS_INLINE [[gnu::always_inline]] inline
+#else
+#define NDARRAY_ALWAYS_INLINE inline
+#endif
+
+namespace nd {
+
+// Accurate: the functions of the standard library. Fast: vectorizable approximations within a
+// few ULP, described in details::fastExp and the following functions.
+enum struct Precision { accurate, fast };
+
+namespace details {
+
+template <class T>
+struct FloatBits;
+
+template <>
+struct FloatBits<float> {
+  using Int = std::uint32_t;
+  using SignedInt = std::int32_t;
+  constexpr static int mantissa = 23;
+  constexpr static Int bias = 127;
+};
+
+template <>
+struct FloatBits<double> {
+  using Int = std::uint64_t;
+  using SignedInt = std::int64_t;
+  constexpr static int mantissa = 52;
+  constexpr static Int bias = 1023;
+};
+
+template <class T>
+constexpr bool has_fast_math = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+// Adding and subtracting 1.5 * 2^mantissa rounds to the nearest integer, which is stored in the
+// low bits of the sum. Valid for |x| < 2^(mantissa - 1).
+template <class T>
+constexpr T round_shift = T(1.5) * T(typename FloatBits<T>::Int(1) << FloatBits<T>::mantissa);
+
+// Branch free selection. A conditional expression would let the compiler move the computation of
+// the unused value behind a jump, which prevents the vectorization of the loop.
+template <class T>
+NDARRAY_ALWAYS_INLINE T select(bool condition, T a, T b) {
+  using Int = typename FloatBits<T>::Int;
+  const Int mask = Int(0) - Int(condition);
+  return std::bit_cast<T>((std::bit_cast<Int>(a) & mask) | (std::bit_cast<Int>(b) & ~mask));
+}
+
+template <class T, std::size_t n>
+NDARRAY_ALWAYS_INLINE T horner(T x, const T (&coefficients)[n]) {
+  T result = coefficients[n - 1];
+  for (std::size_t i = n - 1; i-- > 0;)
+    result = result * x + coefficients[i];
+  return result;
+}
+
+// Exponential within 1 ULP, with subnormal results and overflow to infinity.
+template <class T>
+NDARRAY_ALWAYS_INLINE T fastExp(T x) {
+  using Int = typename FloatBits<T>::Int;
+  using SignedInt = typename FloatBits<T>::SignedInt;
+  constexpr bool is_double = std::is_same_v<T, double>;
+  // Beyond these bounds the result underflows to zero or overflows to infinity.
+  constexpr T max_x = is_double ? 720 : 95;
+  constexpr T min_x = is_double ? -760 : -110;
+  constexpr T log2e = 1.4426950408889634;
+  // ln(2) split into a part exactly multiplied by integers and a correction.
+  constexpr T ln2_hi = is_double ? 6.93147180369123816490e-01 : 0.693145751953125;
+  constexpr T ln2_lo = is_double ? 1.90821492927058770002e-10 : 1.428606765330187045e-06;
+
+  // Taylor coefficients of exp on |r| < ln(2) / 2.
+  constexpr T c_double[] = {1.,
+                            1.,
+                            1. / 2,
+                            1. / 6,
+                            1. / 24,
+                            1. / 120,
+                            1. / 720,
+                            1. / 5040,
+                            1. / 40320,
+                            1. / 362880,
+                            1. / 3628800,
+                            1. / 39916800,
+                            1. / 479001600,
+                            1. / 6227020800};
+  constexpr T c_float[] = {1., 1., 1. / 2, 1. / 6, 1. / 24, 1. / 120, 1. / 720, 1. / 5040};
+
+  // x = k ln(2) + r.
+  const T clamped = select(x < min_x, min_x, select(x > max_x, max_x, x));
+  const T shifted = clamped * log2e + round_shift<T>;
+  const T k = shifted - round_shift<T>;
+  const T r = (clamped - k * ln2_hi) - k * ln2_lo;
+  T p;
+  if constexpr (is_double)
+    p = horner(r, c_double);
+  else
+    p = horner(r, c_float);
+
+  // 2^k = 2^k1 * 2^k2, with both factors normal over the clamped range. NaN propagates through
+  // the clamp.
+  const SignedInt k_int =
+      SignedInt(std::bit_cast<Int>(shifted) - std::bit_cast<Int>(round_shift<T>));
+  const SignedInt k1 = k_int >> 1;
+  const SignedInt k2 = k_int - k1;
+  constexpr int mantissa = FloatBits<T>::mantissa;
+  const T scale1 = std::bit_cast<T>(Int(k1 + SignedInt(FloatBits<T>::bias)) << mantissa);
+  const T scale2 = std::bit_cast<T>(Int(k2 + SignedInt(FloatBits<T>::bias)) << mantissa);
+  return p * scale1 * scale2;
+}
+
+// Natural logarithm within 3 ULP, including subnormal arguments.
+template <class T>
+NDARRAY_ALWAYS_INLINE T fastLog(T x) {
+  using Int = typename FloatBits<T>::Int;
+  constexpr bool is_double = std::is_same_v<T, double>;
+  constexpr int mantissa = FloatBits<T>::mantissa;
+  constexpr T ln2_hi = is_double ? 6.93147180369123816490e-01 : 0.693145751953125;
+  constexpr T ln2_lo = is_double ? 1.90821492927058770002e-10 : 1.428606765330187045e-06;
+
+  // Coefficients of 2 atanh(s) / (2 s) = 1 + s^2 / 3 + s^4 / 5 + ... in s^2.
+  constexpr T c_double[] = {1.,      1. / 3,  1. / 5,  1. / 7,  1. / 9,  1. / 11,
+                            1. / 13, 1. / 15, 1. / 17, 1. / 19, 1. / 21};
+  constexpr T c_float[] = {1., 1. / 3, 1. / 5, 1. / 7, 1. / 9, 1. / 11};
+
+  const bool subnormal = x < std::numeric_limits<T>::min();
+  const T scaled = select(subnormal, x * T(Int(1) << mantissa), x);
+
+  // x = 2^e m, with m in [sqrt(1/2), sqrt(2)).
+  constexpr Int one_bits = std::bit_cast<Int>(T(1));
+  constexpr Int half_sqrt2_bits = std::bit_cast<Int>(T(0.70710678118654752440));
+  const Int bits = std::bit_cast<Int>(scaled) + (one_bits - half_sqrt2_bits);
+  constexpr Int mantissa_mask = (Int(1) << mantissa) - 1;
+  const T m = std::bit_cast<T>((bits & mantissa_mask) + half_sqrt2_bits);
+  // The biased exponent is converted through the mantissa of 2^mantissa.
+  constexpr T magic = T(Int(1) << mantissa);
+  const T e = (std::bit_cast<T>(std::bit_cast<Int>(magic) | (bits >> mantissa)) - magic) -
+              T(FloatBits<T>::bias) - select(subnormal, T(mantissa), T(0));
+
+  // log(m) = 2 atanh(s), with s = (m - 1) / (m + 1).
+  const T f = m - T(1);
+  const T s = f / (T(2) + f);
+  T p;
+  if constexpr (is_double)
+    p = horner(s * s, c_double);
+  else
+    p = horner(s * s, c_float);
+  T result = e * ln2_hi + (e * ln2_lo + T(2) * s * p);
+
+  result = select(x == T(0), -std::numeric_limits<T>::infinity(), result);
+  result = select(!(x >= T(0)), std::numeric_limits<T>::quiet_NaN(), result);
+  return select(x == std::numeric_limits<T>::infinity(), x, result);
+}
+
+// Sine, or cosine, within 3 ULP for |x| < 10^6. The accuracy of larger arguments is limited by
+// the reduction modulo pi / 2. Single precision arguments are evaluated in double precision.
+template <bool cosine>
+NDARRAY_ALWAYS_INLINE double fastSinCos(double x) {
+  using Int = FloatBits<double>::Int;
+  constexpr double two_over_pi = 6.36619772367581382433e-01;
+  // pi / 2 split into parts exactly multiplied by integers, and a correction.
+  constexpr double pio2_1 = 1.57079632673412561417e+00;
+  constexpr double pio2_2 = 6.07710050630396597660e-11;
+  constexpr double pio2_2t = 2.02226624879595063154e-21;
+
+  // Taylor coefficients of sin(r) / r and cos(r) in r^2 on |r| < pi / 4.
+  constexpr double s[] = {1.,
+                          -1. / 6,
+                          1. / 120,
+                          -1. / 5040,
+                          1. / 362880,
+                          -1. / 39916800,
+                          1. / 6227020800,
+                          -1. / 1307674368000};
+  constexpr double c[] = {1.,
+                          -1. / 2,
+                          1. / 24,
+                          -1. / 720,
+                          1. / 40320,
+                          -1. / 3628800,
+                          1. / 479001600,
+                          -1. / 87178291200,
+                          1. / 20922789888000};
+
+  // x = k pi / 2 + r.
+  const double shifted = x * two_over_pi + round_shift<double>;
+  const double k = shifted - round_shift<double>;
+  const double r = ((x - k * pio2_1) - k * pio2_2) - k * pio2_2t;
+  const Int quadrant = std::bit_cast<Int>(shifted) + Int(cosine);
+
+  const double z = r * r;
+  const double sin_r = r * horner(z, s);
+  const double cos_r = horner(z, c);
+  const double result = select(quadrant & 1, cos_r, sin_r);
+  return select(quadrant & 2, -result, result);
+}
+
+// Hyperbolic tangent within 3 ULP.
+template <class T>
+NDARRAY_ALWAYS_INLINE T fastTanh(T x) {
+  constexpr bool is_double = std::is_same_v<T, double>;
+  // Taylor coefficients of tanh(x) / x in x^2 on |x| < 1 / 4.
+  constexpr T c_double[] = {1.,
+                            -1. / 3,
+                            2. / 15,
+                            -17. / 315,
+                            62. / 2835,
+                            -1382. / 155925,
+                            21844. / 6081075,
+                            -929569. / 638512875,
+                            6404582. / 10854718875,
+                            -443861162. / 1856156927625,
+                            18888466084. / 194896477400625};
+  constexpr T c_float[] = {1., -1. / 3, 2. / 15, -17. / 315, 62. / 2835};
+
+  const T a = std::abs(x);
+  T small;
+  if constexpr (is_double)
+    small = a * horner(a * a, c_double);
+  else
+    small = a * horner(a * a, c_float);
+  const T t = fastExp(T(-2) * a);
+  const T large = (T(1) - t) / (T(1) + t);
+  return std::copysign(select(a < T(0.25), small, large), x);
+}
+
+// Error function within 5 ULP, with the rational approximations of W. J. Cody, Math. Comp. 23
+// (1969). Single precision arguments are evaluated in double precision.
+NDARRAY_ALWAYS_INLINE double fastErf(double x) {
+  constexpr double a[] = {3.16112374387056560e00, 1.13864154151050156e02, 3.77485237685302021e02,
+                          3.20937758913846947e03, 1.85777706184603153e-1};
+  constexpr double b[] = {2.36012909523441209e01, 2.44024637934444173e02, 1.28261652607737228e03,
+                          2.84423683343917062e03};
+  constexpr double c[] = {5.64188496988670089e-1, 8.88314979438837594e00, 6.61191906371416295e01,
+                          2.98635138197400131e02, 8.81952221241769090e02, 1.71204761263407058e03,
+                          2.05107837782607147e03, 1.23033935479799725e03, 2.15311535474403846e-8};
+  constexpr double d[] = {1.57449261107098347e01, 1.17693950891312499e02, 5.37181101862009858e02,
+                          1.62138957456669019e03, 3.29079923573345963e03, 4.36261909014324716e03,
+                          3.43936767414372164e03, 1.23033935480374942e03};
+  constexpr double p[] = {3.05326634961232344e-1, 3.60344899949804439e-1, 1.25781726111229246e-1,
+                          1.60837851487422766e-2, 6.58749161529837803e-4, 1.63153871373020978e-2};
+  constexpr double q[] = {2.56852019228982242e00, 1.87295284992346725e00, 5.27905102951428412e-1,
+                          6.05183413124413191e-2, 2.33520497626869185e-3};
+  constexpr double one_over_sqrt_pi = 5.6418958354775628695e-1;
+
+  const double y = std::abs(x);
+
+  // erf(x) for |x| < 0.46875.
+  double z = y * y;
+  double num = a[4] * z, den = z;
+  for (int i = 0; i < 3; ++i) {
+    num = (num + a[i]) * z;
+    den = (den + b[i]) * z;
+  }
+  const double small = x * (num + a[3]) / (den + b[3]);
+
+  // erfc(|x|) exp(x^2) for |x| <= 4.
+  num = c[8] * y;
+  den = y;
+  for (int i = 0; i < 7; ++i) {
+    num = (num + c[i]) * y;
+    den = (den + d[i]) * y;
+  }
+  const double medium = (num + c[7]) / (den + d[7]);
+
+  // erfc(|x|) exp(x^2) for |x| > 4.
+  z = 1 / (y * y);
+  num = p[5] * z;
+  den = z;
+  for (int i = 0; i < 4; ++i) {
+    num = (num + p[i]) * z;
+    den = (den + q[i]) * z;
+  }
+  const double large = (one_over_sqrt_pi - z * (num + p[4]) / (den + q[4])) / y;
+
+  // exp(-y^2) = exp(-t^2) exp(-(y - t)(y + t)), with t^2 exact for t a multiple of 1 / 16.
+  const double yc = select(y < 27., y, 27.);
+  const double t = (yc * 16 + round_shift<double> - round_shift<double>) / 16;
+  const double erfc =
+      select(y <= 4, medium, large) * fastExp(-t * t) * fastExp(-(yc - t) * (yc + t));
+  return select(y < 0.46875, small, std::copysign(1 - erfc, x));
+}
+
+// x^y for x >= 0, as exp(y log(x)). The error of double precision results is up to about
+// 1 + 6 |y log(x)| ULP. Single precision arguments are evaluated in double precision.
+template <class T>
+NDARRAY_ALWAYS_INLINE T fastPow(T x, T y) {
+  const double result = fastExp(double(y) * fastLog(double(x)));
+  return select(y == T(0), T(1), T(result));
+}
+
+// Functors applied to each element. Integers are promoted like by the standard library.
+template <Precision precision>
+struct Exp {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Real = decltype(std::exp(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Real>)
+      return fastExp(Real(a));
+    else
+      return std::exp(a);
+  }
+};
+
+template <Precision precision>
+struct Log {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Real = decltype(std::log(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Real>)
+      return fastLog(Real(a));
+    else
+      return std::log(a);
+  }
+};
+
+template <Precision precision>
+struct Sin {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Real = decltype(std::sin(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Real>)
+      return Real(fastSinCos<false>(double(a)));
+    else
+      return std::sin(a);
+  }
+};
+
+template <Precision precision>
+struct Cos {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Real = decltype(std::cos(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Real>)
+      return Real(fastSinCos<true>(double(a)));
+    else
+      return std::cos(a);
+  }
+};
+
+template <Precision precision>
+struct Tanh {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Real = decltype(std::tanh(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Real>)
+      return fastTanh(Real(a));
+    else
+      return std::tanh(a);
+  }
+};
+
+template <Precision precision>
+struct Erf {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Real = decltype(std::erf(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Real>)
+      return Real(fastErf(double(a)));
+    else
+      return std::erf(a);
+  }
+};
+
+// x^n with O(log n) multiplications.
+template <int n, class T>
+constexpr auto integerPower(const T& x) {
+  using Result = decltype(x * x);
+  if constexpr (n == 0)
+    return Result(1);
+  else if constexpr (n == 1)
+    return Result(x);
+  else {
+    const Result half = integerPower<n / 2>(x);
+    if constexpr (n % 2)
+      return half * half * Result(x);
+    else
+      return half * half;
+  }
+}
+
+// Small integer exponents are expanded into multiplications. The test is invariant in the
+// evaluation loop, and is hoisted out of it by the compiler.
+template <Precision precision, class E>
+struct Power {
+  template <class T>
+  auto operator()(const T& a) const {
+    using Result = decltype(std::pow(a, exponent));
+    if (exponent == E(2))
+      return integerPower<2>(Result(a));
+    if (exponent == E(3))
+      return integerPower<3>(Result(a));
+    if (exponent == E(4))
+      return integerPower<4>(Result(a));
+    if constexpr (precision == Precision::fast && has_fast_math<Result>)
+      return fastPow(Result(a), Result(exponent));
+    else
+      return Result(std::pow(a, exponent));
+  }
+
+  E exponent;
+};
+
+}  // namespace details
+
+template <lazy_evaluated L>
+auto sqrt(const L& l) {
+  return apply([](const auto& a) { return std::sqrt(a); }, l);
+}
+
+// With Precision::fast, the base must be non negative.
+template <Precision precision = Precision::accurate, lazy_evaluated L, class E>
+requires std::is_scalar_v<E> auto pow(const L& l, E exponent) {
+  return nd::apply(details::Power<precision, E>{exponent}, l);
+}
+
+// l^n with a compile time exponent, evaluated with multiplications only.
+template <int n, lazy_evaluated L>
+auto pow(const L& l) {
+  return nd::apply(
+      [](const auto& a) {
+        if constexpr (n < 0) {
+          static_assert(std::is_floating_point_v<std::decay_t<decltype(a)>>,
+                        "Negative exponents of integers are not supported.");
+          return 1 / details::integerPower<-n>(a);
+        }
+        else
+          return details::integerPower<n>(a);
+      },
+      l);
+}
+
+template <Precision precision = Precision::accurate, lazy_evaluated L>
+auto exp(const L& l) {
+  return nd::apply(details::Exp<precision>(), l);
+}
+
+template <Precision precision = Precision::accurate, lazy_evaluated L>
+auto log(const L& l) {
+  return nd::apply(details::Log<precision>(), l);
+}
+
+template <Precision precision = Precision::accurate, lazy_evaluated L>
+auto sin(const L& l) {
+  return nd::apply(details::Sin<precision>(), l);
+}
+
+template <Precision precision = Precision::accurate, lazy_evaluated L>
+auto cos(const L& l) {
+  return nd::apply(details::Cos<precision>(), l);
+}
+
+template <Precision precision = Precision::accurate, lazy_evaluated L>
+auto tanh(const L& l) {
+  return nd::apply(details::Tanh<precision>(), l);
+}
+
+template <Precision precision = Precision::accurate, lazy_evaluated L>
+auto erf(const L& l) {
+  return nd::apply(details::Erf<precision>(), l);
+}
+
+}  // namespace nd
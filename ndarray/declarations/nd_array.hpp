@@ -9,20 +9,86 @@
 
 #pragma once
 
+#include <algorithm>
+#include <iterator>
+#include <span>
 #include <vector>
 
+#include "allocation.hpp"
 #include "brace_initialization.hpp"
 #include "lazy_functions.hpp"
 #include "nd_view.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
 
 namespace nd {
+namespace details {
+
+// std::vector<bool> does not store contiguous bools. Masks are stored as a wrapper of the same size.
+struct Bool {
+  constexpr Bool(bool val = false) noexcept : value(val) {}
+  constexpr operator bool() const noexcept {
+    return value;
+  }
+
+  bool value;
+};
+static_assert(sizeof(Bool) == sizeof(bool));
+
+template <class T>
+struct StorageTypeImpl {
+  using type = T;
+};
+template <>
+struct StorageTypeImpl<bool> {
+  using type = Bool;
+};
+
+template <class T>
+using StorageType = typename StorageTypeImpl<T>::type;
+
+template <class T>
+using Storage = std::vector<StorageType<T>, ArrayAllocator<StorageType<T>, T>>;
+
+// Writes the 'n' elements of 'x' in row major order to 'out', contiguously for contiguous views
+// and linear expressions. A scalar is repeated.
+template <class T, class E>
+void evaluateInto(T* out, std::size_t n, const E& x) {
+  if constexpr (std::is_scalar_v<E>) {
+    std::fill(out, out + n, x);
+  }
+  else {
+    if constexpr (is_nd_view<E>) {
+      if (x.isContiguous()) {
+        std::copy(x.data(), x.data() + n, out);
+        return;
+      }
+    }
+    const bool linear = isLinear(x, x.shape());
+    const bool extended = isExtended(x, x.shape());
+    parallelFor(0, n, evaluation_grain, [&](std::size_t begin, std::size_t end) {
+      if constexpr (contiguous_nd_storage<E>) {
+        if (linear) {
+          for (std::size_t i = begin; i < end; ++i)
+            out[i] = x[i];
+          return;
+        }
+      }
+      T* pos = out + begin;
+      broadcastShapeRange([&](const auto& index) { *pos++ = elementAt(x, index, extended); },
+                          x.shape(), begin, end);
+    });
+  }
+}
+
+}  // namespace details
 
 template <class T, std::size_t dims>
 class NDArray {
 public:
   constexpr static std::size_t dimensions = dims;
-  using iterator = typename std::vector<T>::iterator;
-  using const_iterator = typename std::vector<T>::const_iterator;
+  using iterator = typename std::span<T>::iterator;
+  using const_iterator = typename std::span<const T>::iterator;
   using value_type = T;
 
   constexpr static bool is_nd_object = true;
@@ -39,10 +105,25 @@ public:
     reshape(shape);
   }
 
+  // Array with the axes stored in 'order', e.g. nd::layout::left for column major.
+  NDArray(const std::array<std::size_t, dims>& shape, const AxisOrder<dims>& order)
+      : order_(order) {
+    reshape(shape);
+  }
+
+  // New elements are value initialized according to the allocation policy.
   void reshape(const std::array<std::size_t, dims>& shape){
-    view_.reshape(shape);
-    data_.resize(view_.length(), {});
-    view_.data_ = data_.data();
+    view_.reshape(shape, order_);
+    const std::size_t old_size = data_.size();
+    data_.resize(view_.length());
+    view_.data_ = data();
+
+    if (data_.size() > old_size) {
+      auto* const added = data_.data() + old_size;
+      details::firstTouch(data_.size() - old_size, [&](std::size_t begin, std::size_t end) {
+        std::fill(added + begin, added + end, details::StorageType<T>{});
+      });
+    }
   }
 
   template <class... Ints> requires is_complete_index<dims, Ints...>
@@ -50,64 +131,127 @@ public:
     reshape(std::array<std::size_t, dims>{static_cast<std::size_t>(ns)...});
   }
 
+  // Rows along the leading axis for which storage is allocated. Appending within the capacity does
+  // not reallocate, and keeps views of the array valid.
+  std::size_t capacity() const noexcept {
+    const std::size_t row = rowSize();
+    return row ? data_.capacity() / row : 0;
+  }
+
+  void reserve(std::size_t rows) {
+    data_.reserve(rows * rowSize());
+    view_.data_ = data();
+  }
+
+  // Appends 'x' along the leading axis: a row of dimension dims - 1, a scalar if dims == 1, or
+  // rows of dimension dims. The capacity grows geometrically, so that the cost of an append is
+  // amortized to the copy of the new elements. 'x' must not reference this array. The array must
+  // be row major.
+  template <lazy_evaluated E>
+  void append(const E& x) {
+    assert(details::isRowMajor(order_));
+    constexpr bool single_row = get_dimensions<E> + 1 == dims || (dims == 1 && std::is_scalar_v<E>);
+    static_assert(single_row || get_dimensions<E> == dims, "Dimensions not compatible.");
+
+    auto new_shape = shape();
+    std::size_t new_rows = 1;
+    if constexpr (!std::is_scalar_v<E>) {
+      const auto& x_shape = x.shape();
+      constexpr std::size_t shift = single_row ? 1 : 0;
+      if (!single_row)
+        new_rows = x_shape[0];
+      const bool empty = new_shape[0] == 0 && size() == 0;
+      for (std::size_t d = 1; d < dims; ++d) {
+        assert(empty || new_shape[d] == x_shape[d - shift]);
+        new_shape[d] = x_shape[d - shift];
+      }
+    }
+    new_shape[0] += new_rows;
+
+    const std::size_t old_size = data_.size();
+    std::size_t new_size = 1;
+    for (auto n : new_shape)
+      new_size *= n;
+    if (new_size > data_.capacity())
+      data_.reserve(std::max(new_size, 2 * data_.capacity()));
+    data_.resize(new_size);
+    view_.reshape(new_shape, order_);
+    view_.data_ = data();
+
+    details::evaluateInto(data() + old_size, new_size - old_size, x);
+  }
+
   NDArray(NDInitializer<T, dims> elements) {
     std::array<std::size_t, dims> shape;
     shape.fill(0);
 
-    readData(data_, shape, elements);
+    readData<T>(data_, shape, elements);
 
     view_.reshape(shape);
-    view_.data_ = data_.data();
+    view_.data_ = data();
   }
 
+  // The result has the axis order of the first array operand.
   template <class F, lazy_evaluated... Args> requires (contiguous_nd_storage<LazyFunction<F, Args...>>)
-  NDArray(const LazyFunction<F, Args...>& f) : view_(f.shape()), data_(view_.length()) {
-    view_.data_ = data_.data();
-
-    if(!f.broadcasted()) {
-      for (std::size_t i = 0; i < data_.size(); ++i) {
-        data_[i] = f[i];
-      }
+  NDArray(const LazyFunction<F, Args...>& f)
+      : order_(f.order()), view_(f.shape()), data_(view_.length()) {
+    const auto span = details::evaluationSpan<LazyFunction<F, Args...>>(
+        "NDArray::NDArray", f.shape(), f.broadcasted() ? "broadcast" : "contiguous");
+    view_.reshape(f.shape(), order_);
+    view_.data_ = data();
+
+    if(!f.broadcasted() && !f.mixedOrder()) {
+      evaluateLinear(f);
     }
     else {
-      view_ = f;
+      evaluateOrdered(f);
     }
   }
 
   template <class F, lazy_evaluated... Args> requires (!contiguous_nd_storage<LazyFunction<F, Args...>>)
   NDArray(const LazyFunction<F, Args...>& f) : view_(f.shape()), data_(view_.length()) {
-    view_.data_ = data_.data();
+    const auto span = details::evaluationSpan<LazyFunction<F, Args...>>(
+        "NDArray::NDArray", f.shape(), f.broadcasted() ? "broadcast" : "strided");
+    view_.data_ = data();
     view_ = f;
   }
 
-  NDArray(const NDArray& rhs) {
+  NDArray(const NDArray& rhs) : order_(rhs.order_) {
     view_.copySize(rhs.view_);
-    data_ = rhs.data_;
-    view_.data_ = data_.data();
+    copyData(rhs);
   }
 
   NDArray(const NDView<T, dims>& view) : NDArray(view.shape()) {
     view_ = view;
   }
 
-  NDArray(NDArray&& rhs) : data_(std::move(rhs.data_)){
+  template <class T2, class I>
+  NDArray(const IndexedView<T2, dims, I>& gather) : NDArray(gather.shape()) {
+    gather.gatherInto(view_);
+  }
+
+  NDArray(NDArray&& rhs) : order_(rhs.order_), data_(std::move(rhs.data_)){
     view_.shallowCopy(rhs.view_);
   }
 
   NDArray& operator=(const NDArray& rhs) {
+    order_ = rhs.order_;
     view_.copySize(rhs.view_);
-    data_ = rhs.data_;
+    copyData(rhs);
     return *this;
   }
 
   NDArray& operator=(NDArray&& rhs) {
+    order_ = rhs.order_;
     view_.shallowCopy(rhs);
     data_ = std::move(rhs.data_);
     return *this;
   }
 
   NDArray& operator=(const T& rhs) {
-    std::fill(data_.begin(), data_.end(), rhs);
+    T* const out = data();
+    parallelFor(0, size(), details::evaluation_grain,
+                [&](std::size_t begin, std::size_t end) { std::fill(out + begin, out + end, rhs); });
     return *this;
   }
 
@@ -115,24 +259,42 @@ public:
   // Precondition: f has same shape.
   template <class F, lazy_evaluated... Args> requires (!contiguous_nd_storage<LazyFunction<F, Args...>>)
   NDArray& operator=(const LazyFunction<F, Args...>& f) {
+    const auto span = details::evaluationSpan<LazyFunction<F, Args...>>(
+        "NDArray::operator=", f.shape(), f.broadcasted() ? "broadcast" : "strided");
+    details::recordTemporary<T>();
     NDArray cpy(f);
     return (*this) = std::move(cpy);
   }
   template <class F, lazy_evaluated... Args> requires (contiguous_nd_storage<LazyFunction<F, Args...>>)
   NDArray& operator=(const LazyFunction<F, Args...>& f) {
+    const auto span = details::evaluationSpan<LazyFunction<F, Args...>>(
+        "NDArray::operator=", f.shape(), f.broadcasted() ? "broadcast" : "contiguous");
     if(shape() != f.shape()){
       reshape(f.shape());
     }
 
-    if(!f.broadcasted()) {
-      for (std::size_t i = 0; i < data_.size(); ++i) {
-        data_[i] = f[i];
-      }
+    if(details::isLinear(f, shape(), order_)) {
+      evaluateLinear(f);
     }
     else{
-      view_ = f;
+      evaluateOrdered(f);
+    }
+
+    return *this;
+  }
+
+  template <class T2, class I>
+  NDArray& operator=(const IndexedView<T2, dims, I>& gather) {
+    if (gather.overlaps(view_)) {
+      details::recordTemporary<T>();
+      NDArray cpy(gather);
+      return (*this) = std::move(cpy);
+    }
+    if (shape() != gather.shape()) {
+      reshape(gather.shape());
     }
 
+    gather.gatherInto(view_);
     return *this;
   }
 
@@ -147,14 +309,26 @@ public:
     return view_.shape_;
   }
 
+  // Axes from the slowest to the fastest varying in memory.
+  const AxisOrder<dims>& order() const noexcept {
+    return order_;
+  }
+
   const T& operator[](std::size_t idx) const noexcept {
     assert(idx < data_.size());
-    return data_[idx];
+    return data()[idx];
   }
 
   T& operator[](std::size_t idx) noexcept {
     assert(idx < data_.size());
-    return data_[idx];
+    return data()[idx];
+  }
+
+  T* data() noexcept {
+    return reinterpret_cast<T*>(data_.data());
+  }
+  const T* data() const noexcept {
+    return reinterpret_cast<const T*>(data_.data());
   }
 
   // Return reference to value
@@ -193,6 +367,22 @@ public:
     return view_(std::forward<Args>(ns)...);
   }
 
+  // Return gather views.
+  template <class... Args>
+  requires is_gather_index<dims, Args...> auto operator()(const Args&... ns) {
+    return view_(ns...);
+  }
+  template <class... Args>
+  requires is_gather_index<dims, Args...> auto operator()(const Args&... ns) const {
+    return view_(ns...);
+  }
+
+  // Return masked views.
+  template <class M>
+  requires mask_for<M, dims> auto operator()(const M& mask) {
+    return view_(mask);
+  }
+
   operator NDView<T, dims>() noexcept {
     return view_;
   }
@@ -202,28 +392,105 @@ public:
   }
 
   iterator begin() noexcept {
-    return data_.begin();
+    return std::span<T>(data(), size()).begin();
   }
   iterator end() noexcept {
-    return data_.end();
+    return std::span<T>(data(), size()).end();
   }
-  iterator cbegin() const noexcept {
-    return data_.cbegin();
+  const_iterator begin() const noexcept {
+    return cbegin();
   }
-  iterator cend() const noexcept {
-    return data_.cend();
+  const_iterator end() const noexcept {
+    return cend();
+  }
+  const_iterator cbegin() const noexcept {
+    return std::span<const T>(data(), size()).begin();
+  }
+  const_iterator cend() const noexcept {
+    return std::span<const T>(data(), size()).end();
   }
 
   auto rbegin() noexcept {
-    return data_.rbegin();
+    return std::reverse_iterator<iterator>(end());
   }
   auto rend() noexcept {
-    return data_.rend();
+    return std::reverse_iterator<iterator>(begin());
+  }
+
+  // Copy with the axes stored in 'order', written sequentially.
+  NDArray reordered(const AxisOrder<dims>& order) const {
+    NDArray result(shape(), order);
+    if (order == order_)
+      std::copy(begin(), end(), result.begin());
+    else
+      result.evaluateOrdered(*this);
+    return result;
   }
 
 private:
+  template <class F>
+  void evaluateLinear(const F& f) {
+    T* const out = data();
+    parallelFor(0, size(), details::evaluation_grain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i)
+        out[i] = f[i];
+    });
+  }
+
+  std::size_t rowSize() const noexcept {
+    std::size_t result = 1;
+    for (std::size_t d = 1; d < dims; ++d)
+      result *= shape()[d];
+    return result;
+  }
+
+  // Evaluates the elements in the order they are stored, so that the output and the operands with
+  // the same axis order are accessed sequentially.
+  template <class F>
+  void evaluateOrdered(const F& f) {
+    if constexpr (details::is_lazy_function<F>) {
+      if (details::isRowMajor(order_)) {
+        view_ = f;
+        return;
+      }
+    }
+
+    std::array<std::size_t, dims> stored_shape;
+    for (std::size_t d = 0; d < dims; ++d)
+      stored_shape[d] = shape()[order_[d]];
+    const bool broadcasted = getBroadcasted(f);
+    T* const out = data();
+    parallelFor(0, size(), details::evaluation_grain, [&](std::size_t begin, std::size_t end) {
+      std::array<std::size_t, dims> index;
+      std::size_t i = begin;
+      broadcastShapeRange(
+          [&](const auto& position) {
+            for (std::size_t d = 0; d < dims; ++d)
+              index[order_[d]] = position[d];
+            out[i++] = broadcasted ? f.extendedElement(index) : f(index);
+          },
+          stored_shape, begin, end);
+    });
+  }
+
+  // Copies are first touched like new arrays.
+  void copyData(const NDArray& rhs) {
+    if (data_.size() != rhs.data_.size()) {
+      data_.clear();
+      data_.resize(rhs.data_.size());
+    }
+    view_.data_ = data();
+
+    const auto* const in = rhs.data_.data();
+    auto* const out = data_.data();
+    details::firstTouch(data_.size(), [&](std::size_t begin, std::size_t end) {
+      std::copy(in + begin, in + end, out + begin);
+    });
+  }
+
+  AxisOrder<dims> order_ = layout::right;
   NDView<T, dims> view_;
-  std::vector<T> data_;
+  details::Storage<T> data_;
 };
 
 template<nd_object T>
@@ -17,7 +17,10 @@
 #include <tuple>
 
 #include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/indexed_view.hpp"
+#include "ndarray/declarations/layout.hpp"
 #include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/masked_view.hpp"
 #include "ndarray/declarations/ranges.hpp"
 
 namespace nd {
@@ -25,6 +28,10 @@ namespace nd {
 template <class T, std::size_t n, bool is_const>
 class NDViewIterator;
 
+enum struct TileLayout;
+template <class T, std::size_t dims, std::size_t tile, TileLayout layout>
+class TiledArray;
+
 template <class T, std::size_t dims>
 class NDView {
 public:
@@ -39,6 +46,12 @@ public:
   NDView(const NDView& rhs) = default;
   NDView(NDView&& rhs) = default;
 
+  // View of external memory, which must outlive it. 'strides' are in number of elements. See
+  // makeView for contiguous memory.
+  NDView(T* data, const std::array<std::size_t, dims>& shape,
+         const std::array<std::size_t, dims>& strides)
+      : data_(data), shape_(shape), strides_(strides) {}
+
   NDView& operator=(const T& rhs) {
     broadcast([=](int& a) { a = rhs; }, (*this));
     return *this;
@@ -52,16 +65,32 @@ public:
   template<class F, class... Args>
   NDView& operator=(const LazyFunction<F, Args...>& f);
 
+  template <class T2, class I>
+  NDView& operator=(const IndexedView<T2, dims, I>& gather);
+
   NDView& shallowCopy(const NDView& rhs);
 
   std::size_t length() const noexcept {
     return std::accumulate(shape_.begin(), shape_.end(), 1ul, std::multiplies<std::size_t>());
   }
 
+  // True if the elements are stored contiguously in row major order.
+  bool isContiguous() const noexcept;
+
   const auto& shape() const noexcept {
     return shape_;
   }
 
+  // Distance, in number of elements, between consecutive indices along each axis.
+  const auto& strides() const noexcept {
+    return strides_;
+  }
+
+  // Address of the first element.
+  T* data() const noexcept {
+    return data_;
+  }
+
   template <class... Ints>
   requires is_complete_index<dims, Ints...> const T& operator()(Ints... ns) const noexcept {
     return data_[linindex(ns...)];
@@ -89,6 +118,22 @@ public:
     return static_cast<NDView<const T, new_dims>>(nonconst_view);
   }
 
+  // Selects the entries of a one dimensional integer array along one axis. E.g. view(idx, all).
+  template <class... Args> requires is_gather_index<dims, Args...>
+  auto operator()(const Args&... args) {
+    return details::gatherSlice(*this, args...);
+  }
+  template <class... Args> requires is_gather_index<dims, Args...>
+  auto operator()(const Args&... args) const {
+    return details::gatherSlice(*this, args...);
+  }
+
+  // Selects the elements where a boolean mask of the same shape is true. E.g. view(view < 0) = 0.
+  template <class M> requires mask_for<M, dims>
+  auto operator()(const M& mask) {
+    return MaskedView<T, dims, M>(*this, mask);
+  }
+
   operator NDView<const T, dims>() const noexcept {
     NDView<const T, dims> const_view(data_, shape_, strides_);
     return const_view;
@@ -118,11 +163,14 @@ private:
   friend class NDViewIterator;
   template <class T2, std::size_t n2>
   friend class NDArray;
+  template <class T2, std::size_t n2, std::integral I>
+  friend class IndexedView;
+  template <class T2, std::size_t n2, class M>
+  friend class MaskedView;
+  template <class T2, std::size_t n2, std::size_t tile, TileLayout layout>
+  friend class TiledArray;
 
   NDView() = default;
-  NDView(T* data, const std::array<std::size_t, dims>& shape,
-         const std::array<std::size_t, dims>& strides)
-      : data_(data), shape_(shape), strides_(strides) {}
 
   template <class... Ints> requires is_complete_index<dims, Ints...>
   NDView(Ints... ns) {
@@ -134,6 +182,7 @@ private:
   template <class... Ints> requires is_complete_index<dims, Ints...>
   void reshape(Ints... ns);
   void reshape(const std::array<std::size_t, dims>& ns);
+  void reshape(const std::array<std::size_t, dims>& ns, const AxisOrder<dims>& order);
 
   template <class... Ints> requires is_complete_index<dims, Ints...> ||
                                     is_partial_index<dims, Ints...> std::size_t
@@ -148,8 +197,8 @@ private:
   void copySize(const NDView& rhs);
 
   T* data_ = nullptr;
-  std::array<std::size_t, dims> shape_;
-  std::array<std::size_t, dims> strides_;
+  std::array<std::size_t, dims> shape_{};
+  std::array<std::size_t, dims> strides_{};
 };
 
 template <class T, std::size_t n>
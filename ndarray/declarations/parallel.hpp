@@ -0,0 +1,174 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Thread pool shared by the library and a blocked parallel loop built on top of it.
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace nd {
+namespace details {
+// Minimum number of elements of an array evaluated by each thread.
+constexpr std::size_t evaluation_grain = 1 << 15;
+}  // namespace details
+
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t n_threads) {
+    start(n_threads);
+  }
+
+  ~ThreadPool() {
+    stop();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Pool used by every parallel algorithm of the library.
+  static ThreadPool& getInstance() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+  }
+
+  // True if the caller is one of the workers of any pool.
+  static bool insideWorker() noexcept {
+    return inside_worker_;
+  }
+
+  std::size_t size() const noexcept {
+    return workers_.size();
+  }
+
+  // Joins the current workers and starts n_threads new ones. Must not be called while tasks are
+  // being submitted from other threads.
+  void resize(std::size_t n_threads) {
+    stop();
+    start(n_threads);
+  }
+
+  template <class F>
+  auto enqueue(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using Result = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+    std::future<Result> result = task->get_future();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      tasks_.emplace([task]() { (*task)(); });
+    }
+    condition_.notify_one();
+    return result;
+  }
+
+private:
+  void start(std::size_t n_threads) {
+    stop_ = false;
+    for (std::size_t i = 0; i < n_threads; ++i)
+      workers_.emplace_back([this] { work(); });
+  }
+
+  void stop() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker : workers_)
+      worker.join();
+    workers_.clear();
+  }
+
+  void work() {
+    inside_worker_ = true;
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (stop_ && tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+      task();
+    }
+  }
+
+  static inline thread_local bool inside_worker_ = false;
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stop_ = false;
+};
+
+inline void setNumThreads(std::size_t n_threads) {
+  ThreadPool::getInstance().resize(std::max<std::size_t>(1, n_threads));
+}
+
+inline std::size_t getNumThreads() {
+  return ThreadPool::getInstance().size();
+}
+
+// Splits [begin, end) into at most getNumThreads() contiguous chunks of at least 'grain' elements
+// and calls f(chunk_begin, chunk_end) on each of them concurrently. The calling thread executes
+// the last chunk. Calls from inside a worker are executed serially to avoid deadlocks.
+template <class F>
+void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, F&& f) {
+  if (end <= begin)
+    return;
+
+  const std::size_t n = end - begin;
+  grain = std::max<std::size_t>(grain, 1);
+  const std::size_t n_chunks =
+      ThreadPool::insideWorker() ? 1 : std::min(getNumThreads(), (n + grain - 1) / grain);
+  if (n_chunks <= 1) {
+    f(begin, end);
+    return;
+  }
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(n_chunks - 1);
+  auto chunk_begin = [&](std::size_t chunk) { return begin + (n * chunk) / n_chunks; };
+  for (std::size_t chunk = 0; chunk < n_chunks - 1; ++chunk)
+    futures.emplace_back(ThreadPool::getInstance().enqueue(
+        [&f, b = chunk_begin(chunk), e = chunk_begin(chunk + 1)]() { f(b, e); }));
+
+  // Wait for every chunk before propagating an exception, as the tasks reference 'f'.
+  std::exception_ptr error;
+  try {
+    f(chunk_begin(n_chunks - 1), end);
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+  for (auto& future : futures) {
+    try {
+      future.get();
+    }
+    catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+}  // namespace nd
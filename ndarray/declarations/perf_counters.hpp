@@ -0,0 +1,229 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Hardware performance counters of code regions through Linux perf_event_open. Counters which
+// can not be opened, e.g. because of perf_event_paranoid or on other systems, are reported as
+// unavailable. Defining NDARRAY_PERF also profiles every evaluation by expression type.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <filesystem>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace nd {
+
+// Counts of each event summed over the threads of the process.
+struct PerfCounts {
+  enum Event : std::size_t { cycles, instructions, llc_misses, dtlb_misses };
+  constexpr static std::size_t n_events = 4;
+  constexpr static std::array<const char*, n_events> names{"cycles", "instructions",
+                                                           "llc_misses", "dtlb_misses"};
+
+  PerfCounts& operator+=(const PerfCounts& rhs) noexcept {
+    for (std::size_t i = 0; i < PerfCounts::n_events; ++i)
+      values[i] += rhs.values[i];
+    return *this;
+  }
+  PerfCounts operator-(const PerfCounts& rhs) const noexcept {
+    PerfCounts result = *this;
+    for (std::size_t i = 0; i < PerfCounts::n_events; ++i)
+      result.values[i] -= rhs.values[i];
+    return result;
+  }
+
+  std::array<double, n_events> values{};
+  std::array<bool, n_events> available{};
+};
+
+struct PerfRecord {
+  std::size_t calls = 0;
+  PerfCounts counts;
+};
+
+namespace details {
+
+#ifdef NDARRAY_PERF
+constexpr bool perf_enabled = true;
+#else
+constexpr bool perf_enabled = false;
+#endif
+
+// Counters attached to every thread of the process. Threads are discovered through
+// /proc/self/task at each read, so that the workers of the thread pool are included.
+class PerfMonitor {
+public:
+  static PerfMonitor& getInstance() {
+    static PerfMonitor monitor;
+    return monitor;
+  }
+
+  ~PerfMonitor() {
+#ifdef __linux__
+    for (auto& [tid, fds] : threads_)
+      for (int fd : fds)
+        if (fd >= 0)
+          close(fd);
+#endif
+  }
+
+  PerfCounts read() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    PerfCounts result = retired_;
+#ifdef __linux__
+    std::map<long, bool> alive;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc/self/task", error))
+      alive[std::stol(entry.path().filename().string())] = true;
+
+    for (auto it = threads_.begin(); it != threads_.end();) {
+      if (alive.count(it->first)) {
+        ++it;
+        continue;
+      }
+      retired_ += readThread(it->second);
+      for (int fd : it->second)
+        if (fd >= 0)
+          close(fd);
+      it = threads_.erase(it);
+    }
+    for (const auto& [tid, unused] : alive)
+      if (!threads_.count(tid))
+        threads_[tid] = openThread(tid);
+
+    result = retired_;
+    for (const auto& [tid, fds] : threads_)
+      result += readThread(fds);
+    for (const auto& [tid, fds] : threads_)
+      for (std::size_t i = 0; i < PerfCounts::n_events; ++i)
+        result.available[i] = result.available[i] || fds[i] >= 0;
+#endif
+    return result;
+  }
+
+private:
+  using Fds = std::array<int, PerfCounts::n_events>;
+
+#ifdef __linux__
+  static Fds openThread(long tid) {
+    constexpr std::array<std::pair<std::uint32_t, std::uint64_t>, PerfCounts::n_events> events{{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    }};
+
+    Fds fds;
+    for (std::size_t i = 0; i < PerfCounts::n_events; ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = events[i].first;
+      attr.config = events[i].second;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds[i] = syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+    }
+    return fds;
+  }
+
+  // Counts are scaled by the fraction of time the counter was scheduled, as events are
+  // multiplexed when there are more than hardware counters.
+  static PerfCounts readThread(const Fds& fds) {
+    PerfCounts counts;
+    for (std::size_t i = 0; i < PerfCounts::n_events; ++i) {
+      std::uint64_t data[3];
+      if (fds[i] < 0 || ::read(fds[i], data, sizeof(data)) != sizeof(data))
+        continue;
+      counts.values[i] = data[2] ? double(data[0]) * double(data[1]) / double(data[2]) : 0;
+    }
+    return counts;
+  }
+#endif
+
+  std::mutex mutex_;
+  std::map<long, Fds> threads_;
+  PerfCounts retired_;
+};
+
+inline std::map<std::string, PerfRecord>& perfRecords() {
+  static std::map<std::string, PerfRecord> records;
+  return records;
+}
+
+inline std::mutex& perfRecordsMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+}  // namespace details
+
+// Measures the events of the process between start() and stop().
+class PerfCounters {
+public:
+  void start() {
+    start_ = details::PerfMonitor::getInstance().read();
+  }
+
+  PerfCounts stop() const {
+    const PerfCounts end = details::PerfMonitor::getInstance().read();
+    PerfCounts result = end - start_;
+    result.available = end.available;
+    return result;
+  }
+
+private:
+  PerfCounts start_;
+};
+
+// Adds the events of its lifetime to the record 'name' of perfReport().
+class PerfRegion {
+public:
+  explicit PerfRegion(std::string name) : name_(std::move(name)) {
+    counters_.start();
+  }
+
+  ~PerfRegion() {
+    const PerfCounts counts = counters_.stop();
+    std::unique_lock<std::mutex> lock(details::perfRecordsMutex());
+    auto& record = details::perfRecords()[name_];
+    ++record.calls;
+    record.counts += counts;
+    record.counts.available = counts.available;
+  }
+
+  PerfRegion(const PerfRegion&) = delete;
+  PerfRegion& operator=(const PerfRegion&) = delete;
+
+private:
+  std::string name_;
+  PerfCounters counters_;
+};
+
+// Events of each region, or of each evaluated expression type with NDARRAY_PERF.
+inline std::map<std::string, PerfRecord> perfReport() {
+  std::unique_lock<std::mutex> lock(details::perfRecordsMutex());
+  return details::perfRecords();
+}
+
+inline void resetPerfReport() {
+  std::unique_lock<std::mutex> lock(details::perfRecordsMutex());
+  details::perfRecords().clear();
+}
+
+}  // namespace nd
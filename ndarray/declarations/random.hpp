@@ -0,0 +1,254 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Counter based random number generation and parallel filling of arrays.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <numbers>
+#include <type_traits>
+
+#include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+template <class T, std::size_t dims>
+class NDView;
+template <class T, std::size_t dims>
+class NDArray;
+
+// Block of 128 random bits.
+using RandomBlock = std::array<std::uint32_t, 4>;
+
+namespace details {
+
+// Number of blocks generated together, in a layout suited for vectorization.
+constexpr std::size_t philox_lanes = 16;
+// Minimum number of blocks generated by each thread.
+constexpr std::size_t random_grain = 1 << 13;
+
+inline double uniform53(std::uint32_t hi, std::uint32_t lo) noexcept {
+  const std::uint64_t bits = (std::uint64_t(hi) << 32 | lo) >> 11;
+  return double(bits) * 0x1p-53;
+}
+
+inline float uniform24(std::uint32_t x) noexcept {
+  return float(x >> 8) * 0x1p-24f;
+}
+
+}  // namespace details
+
+// Philox4x32-10 generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"). The
+// block at position 'counter' of stream 'stream' is a pure function of (seed, stream, counter),
+// hence an array is filled with the same values regardless of the number of threads.
+//
+// Each fill draws the following, unused, counters of the stream. Different streams with the same
+// seed are independent, e.g. one per thread or per Monte Carlo walker.
+class RandomEngine {
+public:
+  explicit RandomEngine(std::uint64_t seed = 0, std::uint64_t stream = 0) noexcept
+      : key_{std::uint32_t(seed), std::uint32_t(seed >> 32)}, stream_(stream) {}
+
+  void seed(std::uint64_t seed, std::uint64_t stream = 0) noexcept {
+    key_ = {std::uint32_t(seed), std::uint32_t(seed >> 32)};
+    stream_ = stream;
+    next_ = 0;
+  }
+
+  RandomBlock operator()(std::uint64_t counter) const noexcept {
+    RandomBlock block;
+    generate(counter, 1, &block);
+    return block;
+  }
+
+  // Writes the blocks with counters [first, first + n) into 'out'.
+  void generate(std::uint64_t first, std::size_t n, RandomBlock* out) const noexcept {
+    for (std::size_t start = 0; start < n; start += details::philox_lanes) {
+      const std::size_t lanes = std::min(details::philox_lanes, n - start);
+      std::uint32_t c0[details::philox_lanes], c1[details::philox_lanes];
+      std::uint32_t c2[details::philox_lanes], c3[details::philox_lanes];
+      for (std::size_t l = 0; l < details::philox_lanes; ++l) {
+        const std::uint64_t counter = first + start + l;
+        c0[l] = std::uint32_t(counter);
+        c1[l] = std::uint32_t(counter >> 32);
+        c2[l] = std::uint32_t(stream_);
+        c3[l] = std::uint32_t(stream_ >> 32);
+      }
+
+      std::uint32_t k0 = key_[0], k1 = key_[1];
+      for (int round = 0; round < 10; ++round) {
+        for (std::size_t l = 0; l < details::philox_lanes; ++l) {
+          const std::uint64_t p0 = std::uint64_t(0xD2511F53) * c0[l];
+          const std::uint64_t p1 = std::uint64_t(0xCD9E8D57) * c2[l];
+          const std::uint32_t n0 = std::uint32_t(p1 >> 32) ^ c1[l] ^ k0;
+          const std::uint32_t n2 = std::uint32_t(p0 >> 32) ^ c3[l] ^ k1;
+          c1[l] = std::uint32_t(p1);
+          c3[l] = std::uint32_t(p0);
+          c0[l] = n0;
+          c2[l] = n2;
+        }
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+
+      for (std::size_t l = 0; l < lanes; ++l)
+        out[start + l] = {c0[l], c1[l], c2[l], c3[l]};
+    }
+  }
+
+  // Reserves the next 'n' counters of the stream and returns the first one. Thread safe.
+  std::uint64_t advance(std::uint64_t n) noexcept {
+    return next_.fetch_add(n);
+  }
+
+  // Fills 'view' with values drawn from 'distribution', in parallel.
+  template <class Distribution, class T, std::size_t dims>
+  void fill(const NDView<T, dims>& view, const Distribution& distribution);
+
+  template <class Distribution, class T, std::size_t dims>
+  void fill(NDArray<T, dims>& arr, const Distribution& distribution) {
+    fill(static_cast<NDView<T, dims>>(arr), distribution);
+  }
+
+  // Engine used by nd::rand and the other initialization functions.
+  static RandomEngine& global() {
+    static RandomEngine engine;
+    return engine;
+  }
+
+private:
+  std::array<std::uint32_t, 2> key_;
+  std::uint64_t stream_;
+  std::atomic<std::uint64_t> next_ = 0;
+};
+
+// Distributions map a block of random bits to 'values_per_block' values of type 'value_type'.
+
+template <std::floating_point T>
+struct Uniform {
+  using value_type = T;
+  constexpr static std::size_t values_per_block = std::is_same_v<T, float> ? 4 : 2;
+
+  void operator()(const RandomBlock& bits, T* out) const noexcept {
+    if constexpr (values_per_block == 4) {
+      for (int i = 0; i < 4; ++i)
+        out[i] = low + (high - low) * details::uniform24(bits[i]);
+    }
+    else {
+      out[0] = low + (high - low) * T(details::uniform53(bits[0], bits[1]));
+      out[1] = low + (high - low) * T(details::uniform53(bits[2], bits[3]));
+    }
+  }
+
+  T low = 0;
+  T high = 1;
+};
+
+// Box-Muller transform of pairs of uniform numbers.
+template <std::floating_point T>
+struct Normal {
+  using value_type = T;
+  constexpr static std::size_t values_per_block = std::is_same_v<T, float> ? 4 : 2;
+
+  void operator()(const RandomBlock& bits, T* out) const noexcept {
+    auto pair = [&](T u1, T u2, T* result) {
+      const T radius = std::sqrt(-2 * std::log(1 - u1));  // 1 - u1 is in (0, 1].
+      const T angle = 2 * std::numbers::pi_v<T> * u2;
+      result[0] = mean + stddev * radius * std::cos(angle);
+      result[1] = mean + stddev * radius * std::sin(angle);
+    };
+    if constexpr (values_per_block == 4) {
+      pair(details::uniform24(bits[0]), details::uniform24(bits[1]), out);
+      pair(details::uniform24(bits[2]), details::uniform24(bits[3]), out + 2);
+    }
+    else {
+      pair(T(details::uniform53(bits[0], bits[1])), T(details::uniform53(bits[2], bits[3])), out);
+    }
+  }
+
+  T mean = 0;
+  T stddev = 1;
+};
+
+template <std::floating_point T>
+struct Exponential {
+  using value_type = T;
+  constexpr static std::size_t values_per_block = Uniform<T>::values_per_block;
+
+  void operator()(const RandomBlock& bits, T* out) const noexcept {
+    T u[values_per_block];
+    Uniform<T>()(bits, u);
+    for (std::size_t i = 0; i < values_per_block; ++i)
+      out[i] = -std::log(1 - u[i]) / rate;
+  }
+
+  T rate = 1;
+};
+
+// Uniformly distributed bits.
+template <std::integral T>
+struct RandomBits {
+  using value_type = T;
+  constexpr static std::size_t values_per_block = sizeof(T) <= 4 ? 4 : 2;
+
+  void operator()(const RandomBlock& bits, T* out) const noexcept {
+    if constexpr (values_per_block == 4) {
+      for (int i = 0; i < 4; ++i)
+        out[i] = static_cast<T>(bits[i]);
+    }
+    else {
+      out[0] = static_cast<T>(std::uint64_t(bits[0]) << 32 | bits[1]);
+      out[1] = static_cast<T>(std::uint64_t(bits[2]) << 32 | bits[3]);
+    }
+  }
+};
+
+// Element i of the view, in row major order, is taken from the block i / values_per_block.
+template <class Distribution, class T, std::size_t dims>
+void RandomEngine::fill(const NDView<T, dims>& view, const Distribution& distribution) {
+  constexpr std::size_t per_block = Distribution::values_per_block;
+  const std::size_t n = view.length();
+  const std::size_t n_blocks = (n + per_block - 1) / per_block;
+  const std::uint64_t first = advance(n_blocks);
+  const bool contiguous = view.isContiguous();
+
+  parallelFor(0, n_blocks, details::random_grain, [&](std::size_t begin, std::size_t end) {
+    constexpr std::size_t buffer_blocks = 256;
+    RandomBlock blocks[buffer_blocks];
+    typename Distribution::value_type values[buffer_blocks * per_block];
+
+    for (std::size_t start = begin; start < end; start += buffer_blocks) {
+      const std::size_t count = std::min(buffer_blocks, end - start);
+      generate(first + start, count, blocks);
+      for (std::size_t b = 0; b < count; ++b)
+        distribution(blocks[b], values + b * per_block);
+
+      const std::size_t i_begin = start * per_block;
+      const std::size_t i_end = std::min(n, (start + count) * per_block);
+      if (contiguous) {
+        T* const out = view.data();
+        for (std::size_t i = i_begin; i < i_end; ++i)
+          out[i] = static_cast<T>(values[i - i_begin]);
+      }
+      else {
+        NDView<T, dims> target = view;
+        const auto* value = values;
+        broadcastShapeRange([&](const auto& index) { target(index) = static_cast<T>(*value++); },
+                            view.shape(), i_begin, i_end);
+      }
+    }
+  });
+}
+
+}  // namespace nd
@@ -0,0 +1,111 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Reductions of every element of an expression to a scalar, with an explicit accumulation type.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+namespace details {
+
+// Number of elements reduced into each partial result. It does not depend on the number of
+// threads, so that neither does the result.
+constexpr std::size_t reduction_block = 1 << 15;
+// Independent partial results within a block, which hide the latency of 'op'.
+constexpr std::size_t reduction_lanes = 8;
+
+// Reduction of the elements of 'x' with row major position in [begin, end), with end > begin.
+template <class Acc, class Op, class E, std::size_t dims>
+Acc reduceRange(Op& op, const E& x, const std::array<std::size_t, dims>& shape, bool linear,
+                bool extended, std::size_t begin, std::size_t end) {
+  if constexpr (contiguous_nd_storage<E>) {
+    if (linear && end - begin >= 2 * reduction_lanes) {
+      std::array<Acc, reduction_lanes> lanes;
+      for (std::size_t k = 0; k < reduction_lanes; ++k)
+        lanes[k] = Acc(x[begin + k]);
+      std::size_t i = begin + reduction_lanes;
+      for (; i + reduction_lanes <= end; i += reduction_lanes)
+        for (std::size_t k = 0; k < reduction_lanes; ++k)
+          lanes[k] = Acc(op(lanes[k], Acc(x[i + k])));
+      for (; i < end; ++i)
+        lanes[0] = Acc(op(lanes[0], Acc(x[i])));
+
+      Acc result = lanes[0];
+      for (std::size_t k = 1; k < reduction_lanes; ++k)
+        result = Acc(op(result, lanes[k]));
+      return result;
+    }
+  }
+
+  Acc result{};
+  bool first = true;
+  broadcastShapeRange(
+      [&](const auto& index) {
+        const Acc value = Acc(elementAt(x, index, extended));
+        result = first ? value : Acc(op(result, value));
+        first = false;
+      },
+      shape, begin, end);
+  return result;
+}
+
+}  // namespace details
+
+// Combines 'init' and every element of 'x', converted to Acc, with 'op'. As the elements are
+// combined in an unspecified order, 'op' must be associative and commutative. The input is
+// evaluated lazily, in parallel.
+template <class Op, class Acc, nd_object E>
+Acc reduce(Op op, Acc init, const E& x) {
+  const auto& shape = x.shape();
+  std::size_t n = 1;
+  for (auto s : shape)
+    n *= s;
+  if (n == 0)
+    return init;
+
+  const bool linear = details::isLinear(x, shape);
+  const bool extended = details::isExtended(x, shape);
+
+  const std::size_t n_blocks = (n + details::reduction_block - 1) / details::reduction_block;
+  std::vector<Acc> partials(n_blocks);
+  parallelFor(0, n_blocks, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t block = begin; block < end; ++block)
+      partials[block] = details::reduceRange<Acc>(
+          op, x, shape, linear, extended, block * details::reduction_block,
+          std::min(n, (block + 1) * details::reduction_block));
+  });
+
+  for (const Acc& partial : partials)
+    init = Acc(op(init, partial));
+  return init;
+}
+
+// Sum of the elements of 'x' accumulated in the type Acc, by default the element type of 'x'.
+// E.g. nd::sum<double>(A) accumulates an array of floats in double precision.
+template <class Acc = void, nd_object E>
+auto sum(const E& x) {
+  using Result = std::conditional_t<std::is_void_v<Acc>, details::ElementType<E>, Acc>;
+  return nd::reduce(std::plus<>(), Result(0), x);
+}
+
+template <class Acc = void, nd_object E>
+auto prod(const E& x) {
+  using Result = std::conditional_t<std::is_void_v<Acc>, details::ElementType<E>, Acc>;
+  return nd::reduce(std::multiplies<>(), Result(1), x);
+}
+
+}  // namespace nd
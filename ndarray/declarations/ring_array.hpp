@@ -0,0 +1,170 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Circular buffer of the latest frames of a stream, with a lock free single producer and single
+// consumer.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+#include "ndarray/declarations/external.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/nd_view.hpp"
+
+namespace nd {
+
+// Consecutive frames of a RingArray, possibly wrapping around the end of its storage. The frames
+// are indexed by the leading axis, from the oldest to the latest.
+template <class T, std::size_t dims>
+class RingWindow {
+public:
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = false;
+  constexpr static std::size_t dimensions = dims;
+  using value_type = T;
+
+  RingWindow(const T* data, std::size_t capacity, std::size_t start,
+             const std::array<std::size_t, dims>& shape)
+      : data_(data), capacity_(capacity), start_(start), shape_(shape) {
+    frame_size_ = 1;
+    for (std::size_t d = 1; d < dims; ++d)
+      frame_size_ *= shape_[d];
+  }
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+  std::size_t size() const noexcept {
+    return shape_[0] * frame_size_;
+  }
+
+  const T& operator()(const std::array<std::size_t, dims>& idx) const noexcept {
+    assert(idx[0] < shape_[0]);
+    std::size_t slot = start_ + idx[0];
+    slot = slot >= capacity_ ? slot - capacity_ : slot;
+    std::size_t offset = 0;
+    for (std::size_t d = 1; d < dims; ++d)
+      offset = offset * shape_[d] + idx[d];
+    return data_[slot * frame_size_ + offset];
+  }
+  template <class... Ints> requires is_complete_index<dims, Ints...>
+  const T& operator()(Ints... ns) const noexcept {
+    return (*this)(std::array<std::size_t, dims>{std::size_t(ns)...});
+  }
+
+  template <std::size_t idx_size> requires(idx_size >= dims)
+  const T& extendedElement(const std::array<std::size_t, idx_size>& idx) const noexcept {
+    std::array<std::size_t, dims> own_idx;
+    for (std::size_t d = 0; d < dims; ++d)
+      own_idx[d] = shape_[d] > 1 ? idx[d + idx_size - dims] : 0;
+    return (*this)(own_idx);
+  }
+
+  // Row major view of the frame 'k' of the window.
+  NDView<const T, dims - 1> frame(std::size_t k) const noexcept requires(dims > 1) {
+    assert(k < shape_[0]);
+    std::array<std::size_t, dims - 1> shape;
+    std::copy(shape_.begin() + 1, shape_.end(), shape.begin());
+    return makeView(&(*this)(std::array<std::size_t, dims>{k}), shape);
+  }
+
+  // The window as at most two contiguous row major views: the frames up to the end of the
+  // storage, and the frames wrapped around to its beginning, possibly empty.
+  std::pair<NDView<const T, dims>, NDView<const T, dims>> segments() const noexcept {
+    const std::size_t first = std::min(shape_[0], capacity_ - start_);
+    auto shape = shape_;
+    shape[0] = first;
+    NDView<const T, dims> head = makeView(data_ + start_ * frame_size_, shape);
+    shape[0] = shape_[0] - first;
+    NDView<const T, dims> tail = makeView(data_, shape);
+    return {head, tail};
+  }
+
+private:
+  const T* data_;
+  std::size_t capacity_;
+  std::size_t start_;
+  std::size_t frame_size_;
+  std::array<std::size_t, dims> shape_;
+};
+
+// Stores the latest frames of shape 'frame_shape' of a stream, along the leading axis, without
+// moving them. One thread pushes frames and another one reads windows of the latest frames,
+// without locks. The frames of the last window acquired by the consumer are not overwritten, so
+// that the capacity must exceed the window length by the number of frames the producer may push
+// while a window is in use.
+template <class T, std::size_t dims>
+class RingArray {
+public:
+  static_assert(dims >= 1);
+
+  RingArray(std::size_t capacity, const std::array<std::size_t, dims - 1>& frame_shape) {
+    assert(capacity > 0);
+    std::array<std::size_t, dims> shape;
+    shape[0] = capacity;
+    std::copy(frame_shape.begin(), frame_shape.end(), shape.begin() + 1);
+    storage_.reshape(shape);
+    frame_size_ = storage_.size() / capacity;
+  }
+
+  std::size_t capacity() const noexcept {
+    return storage_.shape()[0];
+  }
+  std::array<std::size_t, dims - 1> frameShape() const noexcept {
+    std::array<std::size_t, dims - 1> shape;
+    std::copy(storage_.shape().begin() + 1, storage_.shape().end(), shape.begin());
+    return shape;
+  }
+  // Number of frames pushed since the construction.
+  std::size_t pushed() const noexcept {
+    return head_.load(std::memory_order_acquire);
+  }
+
+  // Producer: copies 'frame', of dimension dims - 1 or a scalar if dims == 1, after the latest
+  // frame. Returns false, without waiting, if the slot is in the window held by the consumer.
+  template <lazy_evaluated E>
+  bool tryPush(const E& frame) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= capacity())
+      return false;
+
+    if constexpr (!std::is_scalar_v<E>)
+      assert(std::equal(frame.shape().begin(), frame.shape().end(), storage_.shape().begin() + 1));
+    details::evaluateInto(storage_.data() + (head % capacity()) * frame_size_, frame_size_, frame);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer: window of the latest 'length' frames, or fewer if less were pushed or if they
+  // precede the previous window. The frames of the window, and of the following ones, are
+  // not overwritten until the next call.
+  RingWindow<T, dims> window(std::size_t length) {
+    assert(length <= capacity());
+    const std::size_t head = head_.load(std::memory_order_acquire);
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t start = std::max(tail, head - std::min(head, length));
+    tail_.store(start, std::memory_order_release);
+
+    auto shape = storage_.shape();
+    shape[0] = head - start;
+    return RingWindow<T, dims>(storage_.data(), capacity(), start % capacity(), shape);
+  }
+
+private:
+  NDArray<T, dims> storage_;
+  std::size_t frame_size_;
+  // Frames [tail_, head_) may be read by the consumer.
+  alignas(64) std::atomic<std::size_t> head_ = 0;
+  alignas(64) std::atomic<std::size_t> tail_ = 0;
+};
+
+}  // namespace nd
@@ -0,0 +1,173 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Inclusive prefix scans (cumulative sums, products...) along one axis.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+
+#include "ndarray/declarations/broadcast.hpp"
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+namespace details {
+
+// Number of consecutive elements of a row processed at once.
+constexpr std::size_t scan_row_block = 1 << 12;
+// Minimum number of elements scanned by each thread.
+constexpr std::size_t scan_grain = 1 << 15;
+
+// Evaluates the elements of 'x' with row major position in [begin, end) into 'out'.
+template <class E, class Val, std::size_t dims>
+void evaluateRange(const E& x, const std::array<std::size_t, dims>& shape, bool linear,
+                   bool extended, Val* out, std::size_t begin, std::size_t end) {
+  if constexpr (contiguous_nd_storage<E>) {
+    if (linear) {
+      for (std::size_t i = begin; i < end; ++i)
+        out[i] = x[i];
+      return;
+    }
+  }
+  Val* pos = out + begin;
+  broadcastShapeRange([&](const auto& index) { *pos++ = elementAt(x, index, extended); }, shape,
+                      begin, end);
+}
+
+}  // namespace details
+
+// Inclusive scan of 'x' along 'axis' with the associative binary operation 'op': the result at
+// position k along the axis is op(...op(op(x_0, x_1), x_2)..., x_k). The input is evaluated lazily.
+//
+// The result is computed in parallel over the independent fibres when they are enough to occupy
+// every thread. Otherwise the axis is split into blocks that are scanned independently, the total
+// of each block is propagated serially, and each block is then offset by the total of the
+// preceding ones.
+//
+// The elements are accumulated and stored in the type Acc, by default the element type of 'x'.
+template <class Acc = void, class Op, nd_object E>
+auto scan(Op op, const E& x, std::size_t axis = 0) {
+  constexpr std::size_t dims = E::dimensions;
+  using Val = std::conditional_t<std::is_void_v<Acc>, details::ElementType<E>, Acc>;
+
+  const auto& shape = x.shape();
+  assert(axis < dims);
+  NDArray<Val, dims> result(shape);
+  Val* const out = result.data();
+
+  const std::size_t length = shape[axis];
+  std::size_t outer = 1, inner = 1;
+  for (std::size_t i = 0; i < axis; ++i)
+    outer *= shape[i];
+  for (std::size_t i = axis + 1; i < dims; ++i)
+    inner *= shape[i];
+  if (result.size() == 0)
+    return result;
+
+  const bool linear = details::isLinear(x, shape);
+  const bool extended = details::isExtended(x, shape);
+
+  // Evaluates and scans the rows [k_begin, k_end) of the slab 'o', restricted to the inner
+  // positions [i_begin, i_end). The first row is not combined with the previous one. Short
+  // complete rows are contiguous, and are evaluated together.
+  auto scanRows = [&](std::size_t o, std::size_t k_begin, std::size_t k_end, std::size_t i_begin,
+                      std::size_t i_end) {
+    const bool full_rows = i_begin == 0 && i_end == inner && inner <= details::scan_row_block;
+    const std::size_t rows_per_chunk = full_rows ? details::scan_row_block / inner : 1;
+    auto position = [&](std::size_t k) { return (o * length + k) * inner; };
+
+    for (std::size_t i0 = i_begin; i0 < i_end; i0 += details::scan_row_block) {
+      const std::size_t i1 = std::min(i_end, i0 + details::scan_row_block);
+      for (std::size_t k0 = k_begin; k0 < k_end; k0 += rows_per_chunk) {
+        const std::size_t k1 = std::min(k_end, k0 + rows_per_chunk);
+        if (full_rows)
+          details::evaluateRange(x, shape, linear, extended, out, position(k0), position(k1));
+        else
+          details::evaluateRange(x, shape, linear, extended, out, position(k0) + i0,
+                                 position(k0) + i1);
+
+        for (std::size_t k = std::max(k0, k_begin + 1); k < k1; ++k) {
+          Val* const row = out + position(k);
+          const Val* const previous = row - inner;
+          for (std::size_t i = i0; i < i1; ++i)
+            row[i] = op(previous[i], row[i]);
+        }
+      }
+    }
+  };
+
+  const std::size_t row_blocks = (inner + details::scan_row_block - 1) / details::scan_row_block;
+  const std::size_t min_rows = std::max<std::size_t>(1, details::scan_grain / inner);
+  const std::size_t n_blocks = std::min(getNumThreads(), length / min_rows);
+
+  if (outer * row_blocks >= getNumThreads() || n_blocks <= 1) {
+    // Parallel over independent fibres.
+    const std::size_t item_size = length * std::min(inner, details::scan_row_block);
+    const std::size_t grain = std::max<std::size_t>(1, details::scan_grain / item_size);
+    parallelFor(0, outer * row_blocks, grain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t item = begin; item < end; ++item) {
+        const std::size_t o = item / row_blocks;
+        const std::size_t i0 = (item % row_blocks) * details::scan_row_block;
+        scanRows(o, 0, length, i0, std::min(inner, i0 + details::scan_row_block));
+      }
+    });
+    return result;
+  }
+
+  // Parallel over blocks of the scanned axis.
+  auto blockBegin = [&](std::size_t block) { return (length * block) / n_blocks; };
+  auto lastRow = [&](std::size_t o, std::size_t block) {
+    return out + (o * length + blockBegin(block + 1) - 1) * inner;
+  };
+
+  parallelFor(0, n_blocks, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t block = begin; block < end; ++block)
+      for (std::size_t o = 0; o < outer; ++o)
+        scanRows(o, blockBegin(block), blockBegin(block + 1), 0, inner);
+  });
+
+  // The last row of each block becomes the scan of every preceding element.
+  for (std::size_t o = 0; o < outer; ++o)
+    for (std::size_t block = 1; block < n_blocks; ++block) {
+      const Val* const carry = lastRow(o, block - 1);
+      Val* const row = lastRow(o, block);
+      for (std::size_t i = 0; i < inner; ++i)
+        row[i] = op(carry[i], row[i]);
+    }
+
+  parallelFor(1, n_blocks, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t block = begin; block < end; ++block)
+      for (std::size_t o = 0; o < outer; ++o) {
+        const Val* const carry = lastRow(o, block - 1);
+        for (std::size_t k = blockBegin(block); k < blockBegin(block + 1) - 1; ++k) {
+          Val* const row = out + (o * length + k) * inner;
+          for (std::size_t i = 0; i < inner; ++i)
+            row[i] = op(carry[i], row[i]);
+        }
+      }
+  });
+
+  return result;
+}
+
+template <class Acc = void, nd_object E>
+auto cumsum(const E& x, std::size_t axis = 0) {
+  return scan<Acc>(std::plus<>(), x, axis);
+}
+
+template <class Acc = void, nd_object E>
+auto cumprod(const E& x, std::size_t axis = 0) {
+  return scan<Acc>(std::multiplies<>(), x, axis);
+}
+
+}  // namespace nd
@@ -0,0 +1,474 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Sparse matrices in coordinate and compressed row or column format.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+enum struct SparseFormat {
+  csr,  // Compressed sparse rows.
+  csc   // Compressed sparse columns.
+};
+
+// Sparse nd object: a compressed pattern of stored elements, all other elements being zero.
+template <class T>
+concept sparse_object = nd_object<T> && requires { std::decay_t<T>::is_sparse; } &&
+                        std::decay_t<T>::is_sparse == true;
+
+// Unordered list of (row, column, value) entries, used to build a compressed matrix. Entries at
+// the same position are summed. Element access is linear in the number of entries.
+template <class T>
+class CooMatrix {
+public:
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = false;
+  constexpr static std::size_t dimensions = 2;
+  using value_type = T;
+
+  CooMatrix() = default;
+  CooMatrix(std::size_t rows, std::size_t cols) : shape_{rows, cols} {}
+  CooMatrix(const std::array<std::size_t, 2>& shape) : shape_(shape) {}
+
+  void reserve(std::size_t n) {
+    rows_.reserve(n);
+    cols_.reserve(n);
+    values_.reserve(n);
+  }
+
+  void insert(std::size_t i, std::size_t j, const T& value) {
+    assert(i < shape_[0] && j < shape_[1]);
+    rows_.push_back(i);
+    cols_.push_back(j);
+    values_.push_back(value);
+  }
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+  // Number of entries, including duplicates.
+  std::size_t nnz() const noexcept {
+    return values_.size();
+  }
+  const std::vector<std::size_t>& rows() const noexcept {
+    return rows_;
+  }
+  const std::vector<std::size_t>& cols() const noexcept {
+    return cols_;
+  }
+  const std::vector<T>& values() const noexcept {
+    return values_;
+  }
+
+  T operator()(const std::array<std::size_t, 2>& idx) const {
+    T result{};
+    for (std::size_t k = 0; k < values_.size(); ++k)
+      if (rows_[k] == idx[0] && cols_[k] == idx[1])
+        result += values_[k];
+    return result;
+  }
+
+  template <std::size_t idx_size> requires(idx_size >= 2)
+  T extendedElement(const std::array<std::size_t, idx_size>& idx) const {
+    return (*this)({shape_[0] > 1 ? idx[idx_size - 2] : 0, shape_[1] > 1 ? idx[idx_size - 1] : 0});
+  }
+
+private:
+  std::array<std::size_t, 2> shape_{};
+  std::vector<std::size_t> rows_;
+  std::vector<std::size_t> cols_;
+  std::vector<T> values_;
+};
+
+namespace details {
+
+// Axis indexed by the offsets of a compressed format, and axis of the stored indices.
+constexpr std::size_t majorAxis(SparseFormat format) {
+  return format == SparseFormat::csr ? 0 : 1;
+}
+constexpr std::size_t minorAxis(SparseFormat format) {
+  return 1 - majorAxis(format);
+}
+
+// Number of elements along the major axis evaluated by each thread, for 'nnz' stored elements.
+inline std::size_t sparseGrain(std::size_t n_major, std::size_t nnz) {
+  return std::max<std::size_t>(1, evaluation_grain * n_major / std::max<std::size_t>(nnz, 1));
+}
+
+}  // namespace details
+
+template <class T, SparseFormat format>
+class CompressedMatrix;
+
+namespace details {
+template <class T>
+constexpr bool is_compressed_matrix = false;
+template <class T, SparseFormat format>
+constexpr bool is_compressed_matrix<CompressedMatrix<T, format>> = true;
+}  // namespace details
+
+// Matrix storing the non zero elements of each row (csr) or column (csc) sorted by index. The
+// values can be modified, the pattern only by assignment. Lazy products with a scalar or a dense
+// object, e.g. 2 * S * D, are sparse expressions with the same pattern, evaluated only at the
+// stored elements when assigned to a compressed matrix.
+template <class T, SparseFormat format = SparseFormat::csr>
+class CompressedMatrix {
+public:
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = false;
+  constexpr static bool is_sparse = true;
+  constexpr static std::size_t dimensions = 2;
+  using value_type = T;
+
+  CompressedMatrix() : offsets_(1, 0) {}
+  CompressedMatrix(std::size_t rows, std::size_t cols)
+      : CompressedMatrix(std::array<std::size_t, 2>{rows, cols}) {}
+  CompressedMatrix(const std::array<std::size_t, 2>& shape)
+      : shape_(shape), offsets_(majorSize() + 1, 0) {}
+
+  // Sorts the entries of 'coo' and sums the duplicates.
+  CompressedMatrix(const CooMatrix<T>& coo) : CompressedMatrix(coo.shape()) {
+    const auto& major = format == SparseFormat::csr ? coo.rows() : coo.cols();
+    const auto& minor = format == SparseFormat::csr ? coo.cols() : coo.rows();
+
+    std::vector<std::size_t> order(coo.nnz());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      return major[a] != major[b] ? major[a] < major[b] : minor[a] < minor[b];
+    });
+
+    indices_.reserve(order.size());
+    values_.reserve(order.size());
+    for (std::size_t k = 0; k < order.size(); ++k) {
+      const std::size_t e = order[k];
+      if (k > 0 && major[e] == major[order[k - 1]] && minor[e] == minor[order[k - 1]]) {
+        values_.back() += coo.values()[e];
+        continue;
+      }
+      ++offsets_[major[e] + 1];
+      indices_.push_back(minor[e]);
+      values_.push_back(coo.values()[e]);
+    }
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+  }
+
+  // Conversion between the row and column formats.
+  template <SparseFormat other> requires(other != format)
+  explicit CompressedMatrix(const CompressedMatrix<T, other>& rhs)
+      : CompressedMatrix(rhs.shape()) {
+    indices_.resize(rhs.nnz());
+    values_.resize(rhs.nnz());
+    for (auto index : rhs.indices())
+      ++offsets_[index + 1];
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+
+    std::vector<std::size_t> position(offsets_.begin(), offsets_.end() - 1);
+    for (std::size_t m = 0; m + 1 < rhs.offsets().size(); ++m)
+      for (std::size_t k = rhs.offsets()[m]; k < rhs.offsets()[m + 1]; ++k) {
+        const std::size_t p = position[rhs.indices()[k]]++;
+        indices_[p] = m;
+        values_[p] = rhs.values()[k];
+      }
+  }
+
+  // Evaluation of a sparse expression at the elements of its pattern.
+  template <sparse_object E> requires(!details::is_compressed_matrix<E>)
+  CompressedMatrix(const E& e) {
+    *this = e;
+  }
+
+  template <sparse_object E> requires(!details::is_compressed_matrix<E>)
+  CompressedMatrix& operator=(const E& e) {
+    const auto& pattern = e.pattern();
+    if constexpr (std::decay_t<decltype(pattern)>::storage_format != format) {
+      using Other = CompressedMatrix<T, std::decay_t<decltype(pattern)>::storage_format>;
+      *this = CompressedMatrix(Other(e));
+    }
+    else {
+      // 'e' may reference this matrix: evaluate before replacing the pattern.
+      std::vector<T> values(pattern.nnz());
+      const auto& offsets = pattern.offsets();
+      const auto& indices = pattern.indices();
+      const std::size_t n_major = offsets.size() - 1;
+      parallelFor(0, n_major, details::sparseGrain(n_major, pattern.nnz()),
+                  [&](std::size_t begin, std::size_t end) {
+                    std::array<std::size_t, 2> idx;
+                    for (std::size_t m = begin; m < end; ++m) {
+                      idx[details::majorAxis(format)] = m;
+                      for (std::size_t k = offsets[m]; k < offsets[m + 1]; ++k) {
+                        idx[details::minorAxis(format)] = indices[k];
+                        values[k] = e.storedValue(k, idx);
+                      }
+                    }
+                  });
+      if (static_cast<const void*>(&pattern) != this) {
+        shape_ = pattern.shape();
+        offsets_ = offsets;
+        indices_ = indices;
+      }
+      values_ = std::move(values);
+    }
+    return *this;
+  }
+
+  constexpr static SparseFormat storage_format = format;
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+  std::size_t nnz() const noexcept {
+    return values_.size();
+  }
+
+  // Start of the stored elements of each row (csr) or column (csc), followed by nnz().
+  const std::vector<std::size_t>& offsets() const noexcept {
+    return offsets_;
+  }
+  // Column (csr) or row (csc) of each stored element.
+  const std::vector<std::size_t>& indices() const noexcept {
+    return indices_;
+  }
+  std::vector<T>& values() noexcept {
+    return values_;
+  }
+  const std::vector<T>& values() const noexcept {
+    return values_;
+  }
+
+  // Position of the element at 'idx' among the stored ones, or nnz() if it is not stored.
+  std::size_t position(const std::array<std::size_t, 2>& idx) const noexcept {
+    assert(idx[0] < shape_[0] && idx[1] < shape_[1]);
+    const std::size_t m = idx[details::majorAxis(format)];
+    const auto begin = indices_.begin() + offsets_[m];
+    const auto end = indices_.begin() + offsets_[m + 1];
+    const auto it = std::lower_bound(begin, end, idx[details::minorAxis(format)]);
+    return it != end && *it == idx[details::minorAxis(format)] ? it - indices_.begin() : nnz();
+  }
+
+  T operator()(const std::array<std::size_t, 2>& idx) const noexcept {
+    const std::size_t k = position(idx);
+    return k < nnz() ? values_[k] : T{};
+  }
+
+  template <std::size_t idx_size> requires(idx_size >= 2)
+  T extendedElement(const std::array<std::size_t, idx_size>& idx) const noexcept {
+    return (*this)({shape_[0] > 1 ? idx[idx_size - 2] : 0, shape_[1] > 1 ? idx[idx_size - 1] : 0});
+  }
+
+  // Interface of sparse expressions.
+  const CompressedMatrix& pattern() const noexcept {
+    return *this;
+  }
+  const T& storedValue(std::size_t k, const std::array<std::size_t, 2>& /*idx*/) const noexcept {
+    return values_[k];
+  }
+
+  NDArray<T, 2> toNDArray() const {
+    NDArray<T, 2> result(shape_);
+    result = T{};
+    std::array<std::size_t, 2> idx;
+    for (std::size_t m = 0; m + 1 < offsets_.size(); ++m) {
+      idx[details::majorAxis(format)] = m;
+      for (std::size_t k = offsets_[m]; k < offsets_[m + 1]; ++k) {
+        idx[details::minorAxis(format)] = indices_[k];
+        result(idx) = values_[k];
+      }
+    }
+    return result;
+  }
+
+private:
+  std::size_t majorSize() const noexcept {
+    return shape_[details::majorAxis(format)];
+  }
+
+  std::array<std::size_t, 2> shape_{};
+  std::vector<std::size_t> offsets_;
+  std::vector<std::size_t> indices_;
+  std::vector<T> values_;
+};
+
+template <class T>
+using CsrMatrix = CompressedMatrix<T, SparseFormat::csr>;
+template <class T>
+using CscMatrix = CompressedMatrix<T, SparseFormat::csc>;
+
+template <class T, SparseFormat format>
+constexpr bool is_referenced_argument<CompressedMatrix<T, format>> = true;
+template <class T>
+constexpr bool is_referenced_argument<CooMatrix<T>> = true;
+
+// Lazy expression f(s, args...) evaluated only at the stored elements of the sparse object 's',
+// and zero elsewhere. 'f' must map a zero element of 's' to zero.
+template <class F, sparse_object S, lazy_evaluated... Args>
+class SparseFunction {
+public:
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = false;
+  constexpr static bool is_sparse = true;
+  constexpr static std::size_t dimensions = 2;
+  using value_type = std::decay_t<std::invoke_result_t<
+      F, details::ElementType<S>,
+      decltype(details::elementAt(std::declval<const Args&>(), std::array<std::size_t, 2>(),
+                                  false))...>>;
+
+  SparseFunction(F f, const S& s, const Args&... args) : f_(std::move(f)), s_(s), args_(args...) {
+    std::size_t i = 0;
+    for_each_in_tuple(args_, [&](const auto& arg) {
+      if constexpr (!std::is_scalar_v<std::decay_t<decltype(arg)>>) {
+        auto shape = s_.shape();
+        combineShapes(shape, arg.shape());
+        assert(shape == s_.shape());
+      }
+      extended_[i++] = details::isExtended(arg, s_.shape());
+    });
+  }
+
+  const auto& shape() const noexcept {
+    return s_.shape();
+  }
+  const auto& pattern() const noexcept {
+    return s_.pattern();
+  }
+
+  value_type storedValue(std::size_t k, const std::array<std::size_t, 2>& idx) const {
+    return invokeHelper(k, idx, std::make_index_sequence<sizeof...(Args)>());
+  }
+
+  value_type operator()(const std::array<std::size_t, 2>& idx) const {
+    const std::size_t k = pattern().position(idx);
+    return k < pattern().nnz() ? storedValue(k, idx) : value_type{};
+  }
+
+  template <std::size_t idx_size> requires(idx_size >= 2)
+  value_type extendedElement(const std::array<std::size_t, idx_size>& idx) const {
+    const auto& shape = s_.shape();
+    return (*this)({shape[0] > 1 ? idx[idx_size - 2] : 0, shape[1] > 1 ? idx[idx_size - 1] : 0});
+  }
+
+private:
+  template <std::size_t... I>
+  value_type invokeHelper(std::size_t k, const std::array<std::size_t, 2>& idx,
+                          std::index_sequence<I...>) const {
+    return f_(s_.storedValue(k, idx), details::elementAt(std::get<I>(args_), idx, extended_[I])...);
+  }
+
+  F f_;
+  LazyArgument<S> s_;
+  std::tuple<LazyArgument<Args>...> args_;
+  std::array<bool, sizeof...(Args)> extended_{};
+};
+
+// Products with a sparse operand preserve its pattern.
+template <lazy_evaluated L, lazy_evaluated R> requires(sparse_object<L> || sparse_object<R>)
+auto operator*(const L& l, const R& r) {
+  if constexpr (sparse_object<L>)
+    return SparseFunction<std::multiplies<>, L, R>(std::multiplies<>(), l, r);
+  else
+    return SparseFunction<std::multiplies<>, R, L>(std::multiplies<>(), r, l);
+}
+
+template <lazy_evaluated L, lazy_evaluated R> requires(sparse_object<L> && std::is_scalar_v<R>)
+auto operator/(const L& l, const R& r) {
+  return SparseFunction<std::divides<>, L, R>(std::divides<>(), l, r);
+}
+
+// Sparse matrix - vector product, multithreaded over the rows for csr matrices and over the
+// columns for csc matrices.
+template <class T, SparseFormat format, class U>
+auto matmul(const CompressedMatrix<T, format>& a, const NDArray<U, 1>& x) {
+  assert(a.shape()[1] == x.shape()[0]);
+  using R = decltype(T() * U());
+  const auto& offsets = a.offsets();
+  const auto& indices = a.indices();
+  const auto& values = a.values();
+  const std::size_t n_major = offsets.size() - 1;
+  const std::size_t grain = details::sparseGrain(n_major, a.nnz());
+
+  NDArray<R, 1> y(a.shape()[0]);
+  y = R{};
+  if constexpr (format == SparseFormat::csr) {
+    parallelFor(0, n_major, grain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i) {
+        R sum{};
+        for (std::size_t k = offsets[i]; k < offsets[i + 1]; ++k)
+          sum += values[k] * x(indices[k]);
+        y(i) = sum;
+      }
+    });
+  }
+  else {
+    // Each thread accumulates its columns into a private vector.
+    std::mutex mutex;
+    parallelFor(0, n_major, grain, [&](std::size_t begin, std::size_t end) {
+      NDArray<R, 1> partial(y.shape());
+      partial = R{};
+      for (std::size_t j = begin; j < end; ++j)
+        for (std::size_t k = offsets[j]; k < offsets[j + 1]; ++k)
+          partial(indices[k]) += values[k] * x(j);
+      std::lock_guard<std::mutex> lock(mutex);
+      for (std::size_t i = 0; i < partial.size(); ++i)
+        y(i) += partial(i);
+    });
+  }
+  return y;
+}
+
+// Sparse matrix - dense matrix product, into a row major array.
+template <class T, SparseFormat format, class U>
+auto matmul(const CompressedMatrix<T, format>& a, const NDArray<U, 2>& x) {
+  assert(a.shape()[1] == x.shape()[0]);
+  using R = decltype(T() * U());
+  const auto& offsets = a.offsets();
+  const auto& indices = a.indices();
+  const auto& values = a.values();
+  const std::size_t n_major = offsets.size() - 1;
+  const std::size_t n_cols = x.shape()[1];
+  const std::size_t grain = std::max<std::size_t>(
+      1, details::sparseGrain(n_major, a.nnz()) / std::max<std::size_t>(n_cols, 1));
+
+  NDArray<R, 2> y(a.shape()[0], n_cols);
+  y = R{};
+  if constexpr (format == SparseFormat::csr) {
+    parallelFor(0, n_major, grain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; ++i)
+        for (std::size_t k = offsets[i]; k < offsets[i + 1]; ++k)
+          for (std::size_t c = 0; c < n_cols; ++c)
+            y(i, c) += values[k] * x(indices[k], c);
+    });
+  }
+  else {
+    std::mutex mutex;
+    parallelFor(0, n_major, grain, [&](std::size_t begin, std::size_t end) {
+      NDArray<R, 2> partial(y.shape());
+      partial = R{};
+      for (std::size_t j = begin; j < end; ++j)
+        for (std::size_t k = offsets[j]; k < offsets[j + 1]; ++k)
+          for (std::size_t c = 0; c < n_cols; ++c)
+            partial(indices[k], c) += values[k] * x(j, c);
+      std::lock_guard<std::mutex> lock(mutex);
+      for (std::size_t i = 0; i < partial.size(); ++i)
+        y[i] += partial[i];
+    });
+  }
+  return y;
+}
+
+}  // namespace nd
@@ -0,0 +1,158 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Optional counters of the allocations and temporaries of the library. Enabled by defining
+// NDARRAY_STATS before including the library, otherwise they compile to nothing.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+namespace nd {
+
+struct Stats {
+  std::size_t allocations = 0;
+  std::size_t bytes_allocated = 0;
+  // Arrays created internally to evaluate an assignment, e.g. because of aliasing.
+  std::size_t temporaries = 0;
+  std::size_t live_bytes = 0;
+  std::size_t peak_live_bytes = 0;
+};
+
+namespace details {
+
+#ifdef NDARRAY_STATS
+constexpr bool stats_enabled = true;
+#else
+constexpr bool stats_enabled = false;
+#endif
+
+struct StatCounters {
+  Stats load() const noexcept {
+    return Stats{allocations.load(), bytes_allocated.load(), temporaries.load(), live_bytes.load(),
+                 peak_live_bytes.load()};
+  }
+
+  void allocate(std::size_t bytes) noexcept {
+    ++allocations;
+    bytes_allocated += bytes;
+    const std::size_t live = live_bytes += bytes;
+    std::size_t peak = peak_live_bytes.load();
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live))
+      ;
+  }
+
+  void deallocate(std::size_t bytes) noexcept {
+    live_bytes -= bytes;
+  }
+
+  void reset() noexcept {
+    allocations = 0;
+    bytes_allocated = 0;
+    temporaries = 0;
+    peak_live_bytes = live_bytes.load();
+  }
+
+  std::atomic<std::size_t> allocations = 0;
+  std::atomic<std::size_t> bytes_allocated = 0;
+  std::atomic<std::size_t> temporaries = 0;
+  std::atomic<std::size_t> live_bytes = 0;
+  std::atomic<std::size_t> peak_live_bytes = 0;
+};
+
+inline StatCounters& totalCounters() {
+  static StatCounters counters;
+  return counters;
+}
+
+template <class T>
+StatCounters& typeCounters() {
+  static StatCounters counters;
+  return counters;
+}
+
+template <class T>
+inline void recordAllocation([[maybe_unused]] std::size_t bytes) noexcept {
+  if constexpr (stats_enabled) {
+    totalCounters().allocate(bytes);
+    typeCounters<T>().allocate(bytes);
+  }
+}
+
+template <class T>
+inline void recordDeallocation([[maybe_unused]] std::size_t bytes) noexcept {
+  if constexpr (stats_enabled) {
+    totalCounters().deallocate(bytes);
+    typeCounters<T>().deallocate(bytes);
+  }
+}
+
+template <class T>
+inline void recordTemporary() noexcept {
+  if constexpr (stats_enabled) {
+    ++totalCounters().temporaries;
+    ++typeCounters<T>().temporaries;
+  }
+}
+
+}  // namespace details
+
+// Counters since the start of the program or the last resetStats(). All zero if NDARRAY_STATS is
+// not defined.
+inline Stats stats() {
+  return details::totalCounters().load();
+}
+
+// Counters of the arrays of element type T.
+template <class T>
+Stats stats() {
+  return details::typeCounters<T>().load();
+}
+
+// Zeroes the total counters, except for the live bytes. The peak restarts from the current live
+// bytes.
+inline void resetStats() {
+  details::totalCounters().reset();
+}
+
+// Counters restricted to the lifetime of the object. E.g.
+//   ScopedStats scope;
+//   hot_loop();
+//   assert(scope.get().allocations == 0);
+class ScopedStats {
+public:
+  ScopedStats() : start_(stats()) {
+    // The peak is restarted for the scope, and merged back on destruction.
+    auto& counters = details::totalCounters();
+    counters.peak_live_bytes = counters.live_bytes.load();
+  }
+
+  ~ScopedStats() {
+    auto& peak = details::totalCounters().peak_live_bytes;
+    std::size_t current = peak.load();
+    while (start_.peak_live_bytes > current &&
+           !peak.compare_exchange_weak(current, start_.peak_live_bytes))
+      ;
+  }
+
+  ScopedStats(const ScopedStats&) = delete;
+  ScopedStats& operator=(const ScopedStats&) = delete;
+
+  Stats get() const {
+    const Stats now = stats();
+    return Stats{now.allocations - start_.allocations,
+                 now.bytes_allocated - start_.bytes_allocated,
+                 now.temporaries - start_.temporaries, now.live_bytes, now.peak_live_bytes};
+  }
+
+private:
+  Stats start_;
+};
+
+}  // namespace nd
@@ -0,0 +1,341 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Cache tiled application of a function of the neighbourhood of each element (stencil).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+template <class T, std::size_t dims>
+class NDView;
+
+template <std::size_t dims>
+using Offset = std::array<long, dims>;
+
+// Compile time list of the offsets read by a stencil. E.g. the 2D five points Laplacian:
+// StencilPattern<Offset<2>{0, 0}, Offset<2>{-1, 0}, Offset<2>{1, 0}, Offset<2>{0, -1}, Offset<2>{0, 1}>
+template <auto... offsets>
+struct StencilPattern {
+  constexpr static std::size_t size = sizeof...(offsets);
+  constexpr static std::size_t dimensions =
+      std::tuple_size_v<std::common_type_t<decltype(offsets)...>>;
+  constexpr static std::array<Offset<dimensions>, size> values{offsets...};
+
+  // Extent of the pattern before and after the central element along each axis.
+  constexpr static Offset<dimensions> lower = [] {
+    Offset<dimensions> extent{};
+    for (const auto& offset : values)
+      for (std::size_t d = 0; d < dimensions; ++d)
+        extent[d] = std::max(extent[d], -offset[d]);
+    return extent;
+  }();
+  constexpr static Offset<dimensions> upper = [] {
+    Offset<dimensions> extent{};
+    for (const auto& offset : values)
+      for (std::size_t d = 0; d < dimensions; ++d)
+        extent[d] = std::max(extent[d], offset[d]);
+    return extent;
+  }();
+};
+
+enum struct Boundary {
+  skip,      // Elements whose neighbourhood is not entirely inside the array are not computed.
+  periodic,  // Indices wrap around each axis.
+  constant   // Elements outside the array have a fixed value.
+};
+
+namespace details {
+
+// Semi open box [begin, end) of coordinates.
+template <std::size_t dims>
+struct Box {
+  Offset<dims> begin;
+  Offset<dims> end;
+
+  long extent(std::size_t d) const noexcept {
+    return std::max(0l, end[d] - begin[d]);
+  }
+  std::size_t size() const noexcept {
+    std::size_t n = 1;
+    for (std::size_t d = 0; d < dims; ++d)
+      n *= extent(d);
+    return n;
+  }
+
+  Box intersect(const Box& rhs) const noexcept {
+    Box result;
+    for (std::size_t d = 0; d < dims; ++d) {
+      result.begin[d] = std::max(begin[d], rhs.begin[d]);
+      result.end[d] = std::min(end[d], rhs.end[d]);
+    }
+    return result;
+  }
+
+  Box expand(const Offset<dims>& lower, const Offset<dims>& upper, long times) const noexcept {
+    Box result;
+    for (std::size_t d = 0; d < dims; ++d) {
+      result.begin[d] = begin[d] - times * lower[d];
+      result.end[d] = end[d] + times * upper[d];
+    }
+    return result;
+  }
+};
+
+// Strided storage addressed by absolute coordinates: the element at 'c' is
+// data[origin + sum(c * strides)].
+template <class T, std::size_t dims>
+struct Field {
+  T& operator()(const Offset<dims>& c) const noexcept {
+    long pos = origin;
+    for (std::size_t d = 0; d < dims; ++d)
+      pos += c[d] * strides[d];
+    return data[pos];
+  }
+
+  T* data;
+  long origin;
+  Offset<dims> strides;
+};
+
+template <class T, std::size_t dims>
+Field<T, dims> makeField(const NDView<T, dims>& view) {
+  Field<T, dims> field{view.data(), 0, {}};
+  for (std::size_t d = 0; d < dims; ++d)
+    field.strides[d] = view.strides()[d];
+  return field;
+}
+
+// Calls f(c) for each coordinate of 'box', in row major order.
+template <std::size_t dims, class F>
+void forEachCoordinate(const Box<dims>& box, F&& f) {
+  if (box.size() == 0)
+    return;
+  Offset<dims> c = box.begin;
+  while (true) {
+    f(c);
+    int d = int(dims) - 1;
+    for (; d >= 0; --d) {
+      if (++c[d] < box.end[d])
+        break;
+      c[d] = box.begin[d];
+    }
+    if (d < 0)
+      return;
+  }
+}
+
+// Computes the elements of 'box' in 'dst' from the neighbours in 'src', which must be readable.
+// Rows along the last axis are processed with constant increments of the neighbour addresses.
+template <class Pattern, class F, class T, class U, std::size_t dims>
+void applyBox(F& f, const Field<T, dims>& src, const Field<U, dims>& dst, const Box<dims>& box) {
+  constexpr std::size_t last = dims - 1;
+  std::array<long, Pattern::size> deltas;
+  for (std::size_t k = 0; k < Pattern::size; ++k) {
+    deltas[k] = 0;
+    for (std::size_t d = 0; d < dims; ++d)
+      deltas[k] += Pattern::values[k][d] * src.strides[d];
+  }
+
+  Box<dims> rows = box;
+  rows.end[last] = rows.begin[last] + 1;
+  const long n = box.extent(last);
+  const long src_step = src.strides[last];
+  const long dst_step = dst.strides[last];
+
+  forEachCoordinate(rows, [&](const Offset<dims>& c) {
+    const T* const in = &src(c);
+    U* const out = &dst(c);
+    [&]<std::size_t... k>(std::index_sequence<k...>) {
+      for (long i = 0; i < n; ++i)
+        out[i * dst_step] = f(in[i * src_step + deltas[k]]...);
+    }(std::make_index_sequence<Pattern::size>());
+  });
+}
+
+// Reads the element at 'c', applying the boundary condition if it lies outside 'shape'.
+template <class T, std::size_t dims, class V>
+auto boundaryRead(const Field<T, dims>& src, const Offset<dims>& shape, Offset<dims> c,
+                  Boundary boundary, const V& value) {
+  for (std::size_t d = 0; d < dims; ++d) {
+    if (c[d] >= 0 && c[d] < shape[d])
+      continue;
+    if (boundary == Boundary::constant)
+      return static_cast<std::remove_const_t<T>>(value);
+    c[d] = ((c[d] % shape[d]) + shape[d]) % shape[d];
+  }
+  return static_cast<std::remove_const_t<T>>(src(c));
+}
+
+// Splits 'box' into tiles of at most 'tile' elements along each axis, and calls f(tile_box) on
+// each of them in parallel.
+template <std::size_t dims, class F>
+void forEachTile(const Box<dims>& box, const Offset<dims>& tile, F&& f) {
+  Offset<dims> n_tiles;
+  std::size_t total = 1;
+  for (std::size_t d = 0; d < dims; ++d) {
+    n_tiles[d] = (box.extent(d) + tile[d] - 1) / tile[d];
+    total *= n_tiles[d];
+  }
+  if (box.size() == 0)
+    return;
+
+  std::size_t tile_size = 1;
+  for (std::size_t d = 0; d < dims; ++d)
+    tile_size *= std::min(tile[d], box.extent(d));
+  const std::size_t grain = std::max<std::size_t>(1, (1 << 15) / tile_size);
+
+  parallelFor(0, total, grain, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t id = begin; id < end; ++id) {
+      Box<dims> t;
+      std::size_t rest = id;
+      for (int d = int(dims) - 1; d >= 0; --d) {
+        const long tile_id = rest % n_tiles[d];
+        rest /= n_tiles[d];
+        t.begin[d] = box.begin[d] + tile_id * tile[d];
+        t.end[d] = std::min(box.end[d], t.begin[d] + tile[d]);
+      }
+      f(t);
+    }
+  });
+}
+
+template <std::size_t dims>
+Offset<dims> tileShape(long last, long others) {
+  Offset<dims> tile;
+  tile.fill(others);
+  tile.back() = last;
+  return tile;
+}
+
+}  // namespace details
+
+// Computes out(i) = f(in(i + offset_0), in(i + offset_1), ...) for each offset of 'Pattern' and
+// each index i of 'out'. 'in' and 'out' are arrays or views with the same shape, and must not
+// overlap.
+// Elements outside 'in' are treated according to 'boundary'. With Boundary::skip the elements of
+// 'out' whose neighbourhood is not entirely inside the array are left unchanged.
+//
+// With sweeps > 1 the stencil is applied repeatedly, as if out = F(F(...F(in))), and the
+// elements left out by Boundary::skip keep their value from 'in' in the intermediate sweeps.
+// Each tile of 'out' is then computed independently from a tile of 'in' enlarged by the reach of
+// all sweeps, held in a temporary buffer (overlapped temporal blocking).
+template <class Pattern, class F, nd_object In, nd_object Out>
+void stencil(F&& f, const In& in, Out&& out, Boundary boundary = Boundary::skip,
+             std::remove_const_t<typename In::value_type> boundary_value = {},
+             std::size_t sweeps = 1) {
+  constexpr std::size_t dims = In::dimensions;
+  static_assert(Pattern::dimensions == dims, "Pattern and array dimensions differ.");
+  using T = std::remove_const_t<typename In::value_type>;
+  using U = typename std::decay_t<Out>::value_type;
+
+  const NDView<const T, dims> in_view = in;
+  const NDView<U, dims> out_view = out;
+  assert(in_view.shape() == out_view.shape());
+  assert(sweeps > 0);
+
+  const auto src = details::makeField(in_view);
+  const auto dst = details::makeField(out_view);
+  constexpr auto& lower = Pattern::lower;
+  constexpr auto& upper = Pattern::upper;
+
+  details::Box<dims> domain, interior;
+  Offset<dims> shape;
+  for (std::size_t d = 0; d < dims; ++d) {
+    shape[d] = in_view.shape()[d];
+    domain.begin[d] = 0;
+    domain.end[d] = shape[d];
+  }
+  interior = domain.expand(lower, upper, -1);
+
+  if (sweeps == 1) {
+    details::forEachTile(interior, details::tileShape<dims>(1024, 8), [&](const auto& tile) {
+      details::applyBox<Pattern>(f, src, dst, tile);
+    });
+    if (boundary == Boundary::skip)
+      return;
+
+    // Boundary shell: along each axis d the slabs before and after the interior, restricted to
+    // the interior range along the preceding axes.
+    std::vector<details::Box<dims>> shell;
+    for (std::size_t d = 0; d < dims; ++d) {
+      details::Box<dims> low = domain, high = domain;
+      for (std::size_t e = 0; e < d; ++e) {
+        low.begin[e] = high.begin[e] = interior.begin[e];
+        low.end[e] = high.end[e] = interior.end[e];
+      }
+      low.end[d] = std::min(lower[d], shape[d]);
+      high.begin[d] = std::max(lower[d], shape[d] - upper[d]);
+      shell.push_back(low);
+      shell.push_back(high);
+    }
+
+    for (const auto& box : shell)
+      details::forEachCoordinate(box, [&](const Offset<dims>& c) {
+        [&]<std::size_t... k>(std::index_sequence<k...>) {
+          auto neighbour = [&](const Offset<dims>& offset) {
+            Offset<dims> position;
+            for (std::size_t d = 0; d < dims; ++d)
+              position[d] = c[d] + offset[d];
+            return details::boundaryRead(src, shape, position, boundary, boundary_value);
+          };
+          dst(c) = f(neighbour(Pattern::values[k])...);
+        }(std::make_index_sequence<Pattern::size>());
+      });
+    return;
+  }
+
+  // Temporal blocking.
+  const details::Box<dims> target = boundary == Boundary::skip ? interior : domain;
+  const long n_sweeps = sweeps;
+  details::forEachTile(target, details::tileShape<dims>(256, 32), [&](const auto& core) {
+    details::Box<dims> loaded = core.expand(lower, upper, n_sweeps);
+    if (boundary == Boundary::skip)
+      loaded = loaded.intersect(domain);
+
+    std::vector<U> buffer_a(loaded.size()), buffer_b(loaded.size());
+    details::Field<U, dims> a{buffer_a.data(), 0, {}};
+    long stride = 1;
+    for (int d = int(dims) - 1; d >= 0; --d) {
+      a.strides[d] = stride;
+      a.origin -= loaded.begin[d] * stride;
+      stride *= loaded.extent(d);
+    }
+    details::Field<U, dims> b = a;
+    b.data = buffer_b.data();
+
+    details::forEachCoordinate(loaded, [&](const Offset<dims>& c) {
+      a(c) = details::boundaryRead(src, shape, c, boundary, boundary_value);
+    });
+    buffer_b = buffer_a;
+
+    for (long s = 1; s <= n_sweeps; ++s) {
+      details::Box<dims> region = core.expand(lower, upper, n_sweeps - s);
+      if (boundary == Boundary::skip)
+        region = region.intersect(interior);
+      else if (boundary == Boundary::constant)
+        region = region.intersect(domain);
+      details::applyBox<Pattern>(f, a, b, region);
+      std::swap(a, b);
+    }
+
+    details::forEachCoordinate(core, [&](const Offset<dims>& c) { dst(c) = a(c); });
+  });
+}
+
+}  // namespace nd
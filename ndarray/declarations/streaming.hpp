@@ -0,0 +1,202 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Out of core evaluation of expressions, slab by slab along the leading axis.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "ndarray/declarations/nd_array.hpp"
+
+namespace nd {
+
+// Array stored row major in a raw binary file, without header. Rows along the leading axis are
+// read and written on demand, the array is never resident in memory.
+template <class T, std::size_t dims>
+class FileArray {
+public:
+  static_assert(dims >= 1 && std::is_trivially_copyable_v<T>);
+  using value_type = T;
+  constexpr static std::size_t dimensions = dims;
+
+  // Opens the existing file 'path', whose size must match 'shape'.
+  FileArray(std::filesystem::path path, const std::array<std::size_t, dims>& shape)
+      : path_(std::move(path)), shape_(shape) {
+    std::error_code error;
+    const auto bytes = std::filesystem::file_size(path_, error);
+    if (error || bytes != size() * sizeof(T))
+      throw(std::runtime_error("File " + path_.string() + " does not match the array shape"));
+  }
+
+  // Creates or truncates the file 'path', filled with zeros.
+  static FileArray create(std::filesystem::path path, const std::array<std::size_t, dims>& shape) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+      throw(std::runtime_error("Can not create file " + path.string()));
+    out.close();
+    std::filesystem::resize_file(path, productOf(shape) * sizeof(T));
+    return FileArray(std::move(path), shape);
+  }
+
+  // Creates the file 'path' with the content of 'array'.
+  static FileArray create(std::filesystem::path path, const NDArray<T, dims>& array) {
+    auto result = create(std::move(path), array.shape());
+    result.writeRows(0, array);
+    return result;
+  }
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+  std::size_t size() const noexcept {
+    return productOf(shape_);
+  }
+  std::size_t rowSize() const noexcept {
+    return shape_[0] ? size() / shape_[0] : 0;
+  }
+  const std::filesystem::path& path() const noexcept {
+    return path_;
+  }
+
+  // Reads the rows [begin, end) into 'slab', reshaped if needed. Each call opens its own stream,
+  // so that distinct slabs can be transferred concurrently.
+  void readRows(std::size_t begin, std::size_t end, NDArray<T, dims>& slab) const {
+    assert(begin <= end && end <= shape_[0]);
+    assert(details::isRowMajor(slab.order()));
+    auto shape = shape_;
+    shape[0] = end - begin;
+    if (slab.shape() != shape)
+      slab.reshape(shape);
+
+    std::ifstream in(path_, std::ios::binary);
+    in.seekg(begin * rowSize() * sizeof(T));
+    in.read(reinterpret_cast<char*>(slab.data()), slab.size() * sizeof(T));
+    if (!in)
+      throw(std::runtime_error("Can not read file " + path_.string()));
+  }
+
+  // Writes 'slab' to the rows starting at 'begin'.
+  void writeRows(std::size_t begin, const NDArray<T, dims>& slab) const {
+    assert(details::isRowMajor(slab.order()));
+    assert(std::equal(shape_.begin() + 1, shape_.end(), slab.shape().begin() + 1));
+    assert(begin + slab.shape()[0] <= shape_[0]);
+
+    std::fstream out(path_, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(begin * rowSize() * sizeof(T));
+    out.write(reinterpret_cast<const char*>(slab.data()), slab.size() * sizeof(T));
+    if (!out)
+      throw(std::runtime_error("Can not write file " + path_.string()));
+  }
+
+  NDArray<T, dims> load() const {
+    NDArray<T, dims> result;
+    readRows(0, shape_[0], result);
+    return result;
+  }
+
+private:
+  static std::size_t productOf(const std::array<std::size_t, dims>& shape) noexcept {
+    std::size_t result = 1;
+    for (auto n : shape)
+      result *= n;
+    return result;
+  }
+
+  std::filesystem::path path_;
+  std::array<std::size_t, dims> shape_;
+};
+
+// Operand of nd::stream: provides its shape and reads rows of the leading axis into an array.
+// FileArray is a slab source, chunked or remote storage can be adapted to it.
+template <class S>
+concept slab_source = requires(const S& s, NDArray<typename S::value_type, S::dimensions>& slab) {
+  { s.shape() };
+  s.readRows(std::size_t(), std::size_t(), slab);
+};
+
+template <class D>
+concept slab_destination =
+    requires(const D& d, const NDArray<typename D::value_type, D::dimensions>& slab) {
+  { d.shape() };
+  d.writeRows(std::size_t(), slab);
+};
+
+namespace details {
+
+template <class S>
+std::size_t rowBytes(const S& s) {
+  std::size_t result = sizeof(typename S::value_type);
+  for (std::size_t d = 1; d < S::dimensions; ++d)
+    result *= s.shape()[d];
+  return result;
+}
+
+}  // namespace details
+
+// Evaluates destination = f(sources...) slab by slab along the leading axis, where 'f' receives
+// a resident NDArray slab of each source and returns an expression of the same shape as the
+// corresponding slab of 'destination'. Every source must have the leading extent of
+// 'destination'. Slabs are double buffered: the next one is read and the previous result written
+// by I/O threads while the current one is evaluated on the thread pool. The slab buffers use at
+// most 'max_bytes', except that a slab holds at least one row.
+// E.g. nd::stream([](auto& a, auto& b) { return a - b / (2 * b); }, C, 1 << 30, A, B);
+template <class F, slab_destination D, slab_source... Sources>
+void stream(F&& f, const D& destination, std::size_t max_bytes, const Sources&... sources) {
+  const std::size_t n_rows = destination.shape()[0];
+  assert(((sources.shape()[0] == n_rows) && ...));
+
+  const std::size_t bytes_per_row =
+      2 * (details::rowBytes(destination) + (details::rowBytes(sources) + ... + 0));
+  const std::size_t slab_rows =
+      std::clamp<std::size_t>(max_bytes / std::max<std::size_t>(bytes_per_row, 1), 1,
+                              std::max<std::size_t>(n_rows, 1));
+
+  using Inputs = std::tuple<NDArray<typename Sources::value_type, Sources::dimensions>...>;
+  using Output = NDArray<typename D::value_type, D::dimensions>;
+  std::array<Inputs, 2> inputs;
+  std::array<Output, 2> outputs;
+  // Declared after the buffers, so that pending transfers complete before they are destroyed.
+  std::future<void> reading;
+  std::future<void> writing;
+
+  auto read = [&](std::size_t begin, std::size_t slot) {
+    return std::async(std::launch::async, [&, begin, slot]() {
+      const std::size_t end = std::min(begin + slab_rows, n_rows);
+      std::apply([&](auto&... slabs) { (sources.readRows(begin, end, slabs), ...); },
+                 inputs[slot]);
+    });
+  };
+
+  if (n_rows)
+    reading = read(0, 0);
+  for (std::size_t begin = 0, slot = 0; begin < n_rows; begin += slab_rows, slot ^= 1) {
+    reading.get();
+    if (begin + slab_rows < n_rows)
+      reading = read(begin + slab_rows, slot ^ 1);
+
+    outputs[slot] = std::apply(f, std::as_const(inputs[slot]));
+
+    if (writing.valid())
+      writing.get();
+    writing = std::async(std::launch::async, [&destination, &out = outputs[slot], begin]() {
+      destination.writeRows(begin, out);
+    });
+  }
+  if (writing.valid())
+    writing.get();
+}
+
+}  // namespace nd
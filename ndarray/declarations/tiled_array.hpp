@@ -0,0 +1,283 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Array stored by tiles, for locality of the accesses to the neighbourhood of an element.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+#include "ndarray/declarations/lazy_functions.hpp"
+#include "ndarray/declarations/nd_array.hpp"
+#include "ndarray/declarations/nd_view.hpp"
+#include "ndarray/declarations/parallel.hpp"
+
+namespace nd {
+
+// Order of the elements inside a tile.
+enum struct TileLayout {
+  blocked,  // Row major: each tile is a contiguous row major block.
+  morton    // Z-order, interleaving the bits of the indices.
+};
+
+namespace details {
+
+constexpr std::size_t defaultTile(std::size_t dims) {
+  return dims == 1 ? 64 : dims == 2 ? 8 : 4;
+}
+
+// Offset inside a tile of the local index 'l' along axis 'd'. The offset of an element is the sum
+// of the offsets of its indices.
+template <std::size_t dims, std::size_t tile, TileLayout layout>
+constexpr auto localOffsets() {
+  std::array<std::array<std::uint32_t, tile>, dims> offsets{};
+  for (std::size_t d = 0; d < dims; ++d)
+    for (std::size_t l = 0; l < tile; ++l) {
+      if constexpr (layout == TileLayout::blocked) {
+        std::size_t stride = 1;
+        for (std::size_t d2 = d + 1; d2 < dims; ++d2)
+          stride *= tile;
+        offsets[d][l] = l * stride;
+      }
+      else {
+        for (std::size_t bit = 0; (std::size_t(1) << bit) < tile; ++bit)
+          offsets[d][l] |= ((l >> bit) & 1) << (bit * dims + dims - 1 - d);
+      }
+    }
+  return offsets;
+}
+
+}  // namespace details
+
+// Array divided into tiles of 'tile' elements along each axis, each stored contiguously, with
+// the tiles in row major order and the elements of a tile ordered by 'layout'. Accessing the
+// neighbours of an element along any axis touches few cache lines and pages. Arrays whose extents
+// are not multiples of 'tile' are padded.
+template <class T, std::size_t dims, std::size_t tile = details::defaultTile(dims),
+          TileLayout layout = TileLayout::blocked>
+class TiledArray {
+public:
+  static_assert(tile > 0 && (tile & (tile - 1)) == 0, "The tile size must be a power of two.");
+
+  constexpr static bool is_nd_object = true;
+  constexpr static bool contiguous_storage = false;
+  constexpr static std::size_t dimensions = dims;
+  constexpr static std::size_t tile_size = [] {
+    std::size_t size = 1;
+    for (std::size_t d = 0; d < dims; ++d)
+      size *= tile;
+    return size;
+  }();
+  using value_type = T;
+
+  TiledArray() = default;
+
+  template <class... Ints> requires is_complete_index<dims, Ints...>
+  TiledArray(Ints... ns) : TiledArray(std::array<std::size_t, dims>{std::size_t(ns)...}) {}
+
+  TiledArray(const std::array<std::size_t, dims>& shape) {
+    reshape(shape);
+  }
+
+  // Conversion from a row major array or evaluation of an expression, tile by tile.
+  template <nd_object E> requires(std::decay_t<E>::dimensions == dims)
+  explicit TiledArray(const E& e) : TiledArray(e.shape()) {
+    assign(e);
+  }
+
+  template <nd_object E> requires(std::decay_t<E>::dimensions == dims)
+  TiledArray& operator=(const E& e) {
+    if (shape_ != e.shape())
+      reshape(e.shape());
+    assign(e);
+    return *this;
+  }
+
+  TiledArray& operator=(const T& value) {
+    std::fill(data_.begin(), data_.end(), value);
+    return *this;
+  }
+
+  void reshape(const std::array<std::size_t, dims>& shape) {
+    shape_ = shape;
+    std::size_t n_tiles = 1;
+    for (int d = int(dims) - 1; d >= 0; --d) {
+      tiles_[d] = (shape_[d] + tile - 1) / tile;
+      tile_strides_[d] = n_tiles * tile_size;
+      n_tiles *= tiles_[d];
+    }
+    data_.assign(n_tiles * tile_size, T{});
+  }
+
+  const auto& shape() const noexcept {
+    return shape_;
+  }
+  // Number of tiles along each axis.
+  const auto& tiles() const noexcept {
+    return tiles_;
+  }
+  std::size_t size() const noexcept {
+    std::size_t result = 1;
+    for (auto n : shape_)
+      result *= n;
+    return result;
+  }
+
+  // Storage, including the padding.
+  T* data() noexcept {
+    return reinterpret_cast<T*>(data_.data());
+  }
+  const T* data() const noexcept {
+    return reinterpret_cast<const T*>(data_.data());
+  }
+
+  template <class... Ints> requires is_complete_index<dims, Ints...>
+  T& operator()(Ints... ns) noexcept {
+    return data()[offset(std::array<std::size_t, dims>{std::size_t(ns)...})];
+  }
+  template <class... Ints> requires is_complete_index<dims, Ints...>
+  const T& operator()(Ints... ns) const noexcept {
+    return data()[offset(std::array<std::size_t, dims>{std::size_t(ns)...})];
+  }
+  T& operator()(const std::array<std::size_t, dims>& idx) noexcept {
+    return data()[offset(idx)];
+  }
+  const T& operator()(const std::array<std::size_t, dims>& idx) const noexcept {
+    return data()[offset(idx)];
+  }
+
+  template <std::size_t idx_size> requires(idx_size >= dims)
+  const T& extendedElement(const std::array<std::size_t, idx_size>& idx) const noexcept {
+    std::array<std::size_t, dims> own_idx;
+    for (std::size_t d = 0; d < dims; ++d)
+      own_idx[d] = shape_[d] > 1 ? idx[d + idx_size - dims] : 0;
+    return (*this)(own_idx);
+  }
+
+  // Row major view of the tile at 'tile_idx' in the tile grid, excluding the padding.
+  NDView<T, dims> tileView(const std::array<std::size_t, dims>& tile_idx) noexcept
+      requires(layout == TileLayout::blocked) {
+    std::array<std::size_t, dims> shape, strides;
+    std::size_t stride = 1;
+    for (int d = int(dims) - 1; d >= 0; --d) {
+      assert(tile_idx[d] < tiles_[d]);
+      shape[d] = std::min(tile, shape_[d] - tile_idx[d] * tile);
+      strides[d] = stride;
+      stride *= tile;
+    }
+    return NDView<T, dims>(data() + tileOffset(tile_idx), shape, strides);
+  }
+
+  // Calls f(index, element) on each element, in parallel over the tiles and in storage order.
+  template <class F>
+  void forEach(F&& f) {
+    forEachIndex([&](const auto& idx, std::size_t offset) { f(idx, data()[offset]); });
+  }
+  template <class F>
+  void forEach(F&& f) const {
+    forEachIndex([&](const auto& idx, std::size_t offset) { f(idx, data()[offset]); });
+  }
+
+  NDArray<T, dims> toNDArray() const {
+    NDArray<T, dims> result(shape_);
+    forEach([&](const auto& idx, const T& x) { result(idx) = x; });
+    return result;
+  }
+
+private:
+  constexpr static std::size_t tile_bits = [] {
+    std::size_t bits = 0;
+    while ((std::size_t(1) << bits) < tile)
+      ++bits;
+    return bits;
+  }();
+  constexpr static auto local_offsets = details::localOffsets<dims, tile, layout>();
+
+  std::size_t offset(const std::array<std::size_t, dims>& idx) const noexcept {
+    std::size_t result = 0;
+    for (std::size_t d = 0; d < dims; ++d) {
+      assert(idx[d] < shape_[d]);
+      result += (idx[d] >> tile_bits) * tile_strides_[d] + local_offsets[d][idx[d] & (tile - 1)];
+    }
+    return result;
+  }
+
+  std::size_t tileOffset(const std::array<std::size_t, dims>& tile_idx) const noexcept {
+    std::size_t result = 0;
+    for (std::size_t d = 0; d < dims; ++d)
+      result += tile_idx[d] * tile_strides_[d];
+    return result;
+  }
+
+  // Calls f(index, offset) on the elements of each tile, skipping the padding.
+  template <class F>
+  void forEachIndex(F&& f) const {
+    std::size_t n_tiles = 1;
+    for (auto n : tiles_)
+      n_tiles *= n;
+    const std::size_t grain = std::max<std::size_t>(1, details::evaluation_grain / tile_size);
+
+    parallelFor(0, n_tiles, grain, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t t = begin; t < end; ++t) {
+        std::array<std::size_t, dims> origin, extent;
+        std::size_t rest = t;
+        for (int d = int(dims) - 1; d >= 0; --d) {
+          origin[d] = (rest % tiles_[d]) * tile;
+          rest /= tiles_[d];
+          extent[d] = std::min(tile, shape_[d] - origin[d]);
+        }
+        const std::size_t base = t * tile_size;
+
+        std::array<std::size_t, dims> local{};
+        std::array<std::size_t, dims> idx = origin;
+        while (true) {
+          std::size_t offset = base;
+          for (std::size_t d = 0; d < dims; ++d)
+            offset += local_offsets[d][local[d]];
+          f(idx, offset);
+
+          int d = int(dims) - 1;
+          for (; d >= 0; --d) {
+            if (++local[d] < extent[d]) {
+              ++idx[d];
+              break;
+            }
+            local[d] = 0;
+            idx[d] = origin[d];
+          }
+          if (d < 0)
+            break;
+        }
+      }
+    });
+  }
+
+  template <class E>
+  void assign(const E& e) {
+    assert(e.shape() == shape_);
+    if constexpr (std::is_same_v<E, TiledArray>) {
+      if (&e != this)
+        data_ = e.data_;
+    }
+    else {
+      const bool extended = details::isExtended(e, shape_);
+      T* const out = data();
+      forEachIndex([&](const auto& idx, std::size_t offset) {
+        out[offset] = details::elementAt(e, idx, extended);
+      });
+    }
+  }
+
+  std::array<std::size_t, dims> shape_{};
+  std::array<std::size_t, dims> tiles_{};
+  std::array<std::size_t, dims> tile_strides_{};
+  details::Storage<T> data_;
+};
+
+}  // namespace nd
@@ -0,0 +1,224 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Optional tracing of the evaluations in the Chrome trace format, readable by chrome://tracing
+// and Perfetto. Enabled by defining NDARRAY_TRACE before including the library, otherwise the
+// hooks compile to nothing. The same hooks collect hardware counters with NDARRAY_PERF.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+#include "ndarray/declarations/perf_counters.hpp"
+
+namespace nd {
+namespace details {
+
+#ifdef NDARRAY_TRACE
+constexpr bool trace_enabled = true;
+#else
+constexpr bool trace_enabled = false;
+#endif
+
+inline std::string demangle(const char* name) {
+#if __has_include(<cxxabi.h>)
+  int status = 0;
+  std::unique_ptr<char, void (*)(void*)> result(
+      abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+  if (status == 0)
+    return result.get();
+#endif
+  return name;
+}
+
+struct TraceEvent {
+  std::string name;
+  std::string signature;
+  std::string shape;
+  std::size_t elements;
+  const char* path;
+  double start;  // Microseconds.
+  double duration;
+  int thread;
+};
+
+class Tracer {
+public:
+  static Tracer& getInstance() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  bool active() const noexcept {
+    return active_.load(std::memory_order_relaxed);
+  }
+
+  void start() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    events_.clear();
+    active_ = true;
+  }
+
+  void stop(const std::string& filename) {
+    active_ = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::ofstream out(filename);
+    if (!out)
+      throw(std::runtime_error("Can not open trace file " + filename));
+
+    out << "{\"traceEvents\":[";
+    for (std::size_t i = 0; i < events_.size(); ++i) {
+      const auto& e = events_[i];
+      out << (i ? ",\n" : "\n") << "{\"name\":\"" << escape(e.name) << "\",\"cat\":\"" << e.path
+          << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread << ",\"ts\":" << e.start
+          << ",\"dur\":" << e.duration << ",\"args\":{\"expression\":\"" << escape(e.signature)
+          << "\",\"shape\":\"" << e.shape << "\",\"elements\":" << e.elements << ",\"path\":\""
+          << e.path << "\"}}";
+    }
+    out << "\n]}\n";
+    events_.clear();
+  }
+
+  double now() const noexcept {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin_)
+        .count();
+  }
+
+  void record(TraceEvent&& event) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    events_.push_back(std::move(event));
+  }
+
+  // Small integer identifying the calling thread.
+  static int threadId() {
+    static std::atomic<int> n_threads = 0;
+    static thread_local const int id = n_threads++;
+    return id;
+  }
+
+private:
+  static std::string escape(const std::string& s) {
+    std::string result;
+    for (char c : s) {
+      if (c == '"' || c == '\\')
+        result += '\\';
+      result += c;
+    }
+    return result;
+  }
+
+  std::atomic<bool> active_ = false;
+  std::mutex mutex_;
+  std::vector<TraceEvent> events_;
+  const std::chrono::steady_clock::time_point origin_ = std::chrono::steady_clock::now();
+};
+
+// Records an event spanning its lifetime, if the tracer is active.
+class TraceSpan {
+public:
+  template <std::size_t dims>
+  TraceSpan(const char* name, const std::type_info& expression,
+            const std::array<std::size_t, dims>& shape, const char* path) {
+    auto& tracer = Tracer::getInstance();
+    if (!tracer.active())
+      return;
+
+    event_ = std::make_unique<TraceEvent>();
+    event_->name = name;
+    event_->signature = demangle(expression.name());
+    event_->elements = 1;
+    event_->shape = "(";
+    for (std::size_t d = 0; d < dims; ++d) {
+      event_->shape += (d ? ", " : "") + std::to_string(shape[d]);
+      event_->elements *= shape[d];
+    }
+    event_->shape += ")";
+    event_->path = path;
+    event_->thread = Tracer::threadId();
+    event_->start = tracer.now();
+  }
+
+  ~TraceSpan() {
+    if (!event_)
+      return;
+    auto& tracer = Tracer::getInstance();
+    event_->duration = tracer.now() - event_->start;
+    tracer.record(std::move(*event_));
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+  std::unique_ptr<TraceEvent> event_;
+};
+
+struct NoTrace {
+  template <class... Args>
+  explicit NoTrace(Args&&...) noexcept {}
+};
+
+template <class Expression>
+const std::string& expressionName() {
+  static const std::string name = demangle(typeid(Expression).name());
+  return name;
+}
+
+// Trace span and hardware counters region of an evaluation, as enabled.
+template <class Expression>
+class EvaluationSpan {
+public:
+  template <std::size_t dims>
+  EvaluationSpan(const char* name, const std::array<std::size_t, dims>& shape, const char* path)
+      : trace_(name, typeid(Expression), shape, path), perf_(expressionName<Expression>()) {}
+
+private:
+  std::conditional_t<trace_enabled, TraceSpan, NoTrace> trace_;
+  std::conditional_t<perf_enabled, PerfRegion, NoTrace> perf_;
+};
+
+// Returns the span of the evaluation of 'Expression', or an empty object if neither tracing nor
+// profiling is enabled.
+template <class Expression, std::size_t dims>
+inline auto evaluationSpan([[maybe_unused]] const char* name,
+                           [[maybe_unused]] const std::array<std::size_t, dims>& shape,
+                           [[maybe_unused]] const char* path) {
+  if constexpr (trace_enabled || perf_enabled)
+    return EvaluationSpan<Expression>(name, shape, path);
+  else
+    return NoTrace();
+}
+
+}  // namespace details
+
+// Starts recording the evaluations, discarding the previous ones.
+inline void startTracing() {
+  details::Tracer::getInstance().start();
+}
+
+// Stops recording and writes the evaluations to 'filename' in the Chrome trace format. The file
+// contains no events if NDARRAY_TRACE is not defined.
+inline void stopTracing(const std::string& filename) {
+  details::Tracer::getInstance().stop(filename);
+}
+
+}  // namespace nd
@@ -15,6 +15,8 @@
 #include <numeric>
 
 #include "ndarray/declarations/nd_view_iterator.hpp"
+#include "ndarray/declarations/parallel.hpp"
+#include "ndarray/declarations/trace.hpp"
 
 namespace nd {
 
@@ -22,10 +24,31 @@ template <class T, std::size_t dims>
 template<class F, class... Args>
 NDView<T, dims>& NDView<T, dims>::operator=(const LazyFunction<F, Args...>& f){
   assert(shape() == f.shape());
-  if(!f.broadcasted())
-    broadcastShape([&](const auto& index){(*this)(index) = f(index); }, shape_);
-  else
-    broadcastShape([&](const auto& index){extendedElement(index) = f.extendedElement(index); }, shape_);
+  const bool broadcasted = f.broadcasted();
+  const auto span = details::evaluationSpan<LazyFunction<F, Args...>>(
+      "NDView::operator=", shape_, broadcasted ? "broadcast" : "strided");
+  parallelFor(0, length(), details::evaluation_grain, [&](std::size_t begin, std::size_t end) {
+    if (!broadcasted)
+      broadcastShapeRange([&](const auto& index) { (*this)(index) = f(index); }, shape_, begin, end);
+    else
+      broadcastShapeRange(
+          [&](const auto& index) { extendedElement(index) = f.extendedElement(index); }, shape_,
+          begin, end);
+  });
+  return *this;
+}
+
+template <class T, std::size_t dims>
+template <class T2, class I>
+NDView<T, dims>& NDView<T, dims>::operator=(const IndexedView<T2, dims, I>& gather) {
+  assert(shape() == gather.shape());
+  if (gather.overlaps(*this)) {
+    details::recordTemporary<std::remove_const_t<T>>();
+    NDArray<T, dims> tmp(gather);
+    return (*this) = static_cast<NDView>(tmp);
+  }
+
+  gather.gatherInto(*this);
   return *this;
 }
 
@@ -100,6 +123,13 @@ void NDView<T, dims>::reshape(const std::array<std::size_t, dims>& ns) {
     strides_[i] = strides_[i + 1] * shape_[i + 1];
 }
 
+template <class T, std::size_t dims>
+void NDView<T, dims>::reshape(const std::array<std::size_t, dims>& ns,
+                              const AxisOrder<dims>& order) {
+  shape_ = ns;
+  strides_ = details::contiguousStrides(shape_, order);
+}
+
 template <class T, std::size_t dims>
 template <class... Ints> requires is_complete_index<dims, Ints...>
 void NDView<T, dims>::reshape(Ints... ns) {
@@ -150,6 +180,17 @@ std::size_t NDView<T, dims>::linindexExtended(const std::array<std::size_t, id_s
   return lid;
 }
 
+template <class T, std::size_t dims>
+bool NDView<T, dims>::isContiguous() const noexcept {
+  std::size_t expected_stride = 1;
+  for (int i = int(dims) - 1; i >= 0; --i) {
+    if (shape_[i] != 1 && strides_[i] != expected_stride)
+      return false;
+    expected_stride *= shape_[i];
+  }
+  return true;
+}
+
 template <class T, std::size_t dims>
 void NDView<T, dims>::copySize(const NDView& rhs) {
   shape_ = rhs.shape_;
@@ -9,11 +9,34 @@
 
 #pragma once
 
+#include "declarations/allocation.hpp"
+#include "declarations/async.hpp"
+#include "declarations/batch.hpp"
 #include "declarations/broadcast.hpp"
+#include "declarations/compression.hpp"
+#include "declarations/dlpack.hpp"
+#include "declarations/dyn_array.hpp"
+#include "declarations/external.hpp"
+#include "declarations/fft.hpp"
+#include "declarations/indexed_view.hpp"
 #include "declarations/init_array.hpp"
 #include "declarations/lazy_functions.hpp"
+#include "declarations/masked_view.hpp"
+#include "declarations/math.hpp"
 #include "declarations/nd_array.hpp"
 #include "declarations/nd_view.hpp"
+#include "declarations/parallel.hpp"
+#include "declarations/perf_counters.hpp"
+#include "declarations/random.hpp"
+#include "declarations/reduction.hpp"
+#include "declarations/ring_array.hpp"
+#include "declarations/scan.hpp"
+#include "declarations/sparse.hpp"
+#include "declarations/stats.hpp"
+#include "declarations/stencil.hpp"
+#include "declarations/streaming.hpp"
+#include "declarations/tiled_array.hpp"
+#include "declarations/trace.hpp"
 
 #include "implementations/nd_view.hpp"
 #include "implementations/nd_view_iterator.hpp"
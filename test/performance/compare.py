@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Copyright (C) 2020 Giovanni Balduzzi
+# All rights reserved.
+#
+# See LICENSE for terms of usage.
+#
+# Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+#
+# Compares two JSON outputs of a Google Benchmark executable and flags the cases whose time
+# increased by more than a threshold. Returns a non zero exit code if any regression is found.
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        runs = json.load(f)["benchmarks"]
+    return {run["name"]: run for run in runs if run.get("run_type", "iteration") == "iteration"}
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("reference")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.1,
+                        help="Relative increase of the time considered a regression.")
+    args = parser.parse_args()
+
+    reference = load(args.reference)
+    current = load(args.current)
+
+    regressions = 0
+    print(f"{'Benchmark':<70} {'Reference':>12} {'Current':>12} {'Change':>8}")
+    for name, run in current.items():
+        if name not in reference:
+            continue
+        old = reference[name]["real_time"]
+        new = run["real_time"]
+        change = new / old - 1
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<70} {old:>12.4g} {new:>12.4g} {change:>+8.1%}{flag}")
+
+    missing = set(reference) - set(current)
+    if missing:
+        print(f"{len(missing)} reference cases were not run.")
+    print(f"{regressions} regressions above {args.threshold:.0%}.")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,180 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Parametrized performance test of lazy evaluation over sizes, dimensions, layouts, types and
+// number of threads. Each case reports its throughput, the ratio of its time to a hand written
+// loop over the same data and the hardware events per element.
+
+#include "ndarray/nd_array.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace nd;
+
+enum class Layout { contiguous, strided, broadcast };
+
+// Cube of 'dims' dimensions with approximately 'elements' elements.
+template <std::size_t dims>
+std::array<std::size_t, dims> cubeShape(std::size_t elements) {
+  std::array<std::size_t, dims> shape;
+  shape.fill(std::max<std::size_t>(1, std::lround(std::pow(double(elements), 1. / dims))));
+  return shape;
+}
+
+template <std::size_t dims>
+std::size_t product(const std::array<std::size_t, dims>& shape) {
+  std::size_t n = 1;
+  for (auto s : shape)
+    n *= s;
+  return n;
+}
+
+template <class T, std::size_t dims>
+NDArray<T, dims> randomArray(const std::array<std::size_t, dims>& shape) {
+  NDArray<T, dims> arr(shape);
+  RandomEngine(0).fill(arr, Uniform<T>{1, 2});
+  return arr;
+}
+
+// Times 'iterations' calls of f.
+template <class F>
+double measure(std::size_t iterations, F&& f) {
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+    f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs the benchmark loop of 'evaluate' and reports the throughput of 'streams' arrays of 'n'
+// elements of type T, and the ratio of the time to the one of 'baseline'.
+template <class T, class F, class B>
+void run(benchmark::State& state, std::size_t n, std::size_t streams, F&& evaluate, B&& baseline) {
+  std::size_t iterations = 0;
+  PerfCounters counters;
+  counters.start();
+  const auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    evaluate();
+    ++iterations;
+  }
+  const double time =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const PerfCounts counts = counters.stop();
+
+  baseline();  // Warm up.
+  const double baseline_time = measure(iterations, baseline);
+
+  state.SetItemsProcessed(state.iterations() * n);
+  state.SetBytesProcessed(state.iterations() * n * streams * sizeof(T));
+  state.counters["baseline_ratio"] = time / baseline_time;
+  // Hardware events per element, if the counters can be opened.
+  for (std::size_t i = 0; i < PerfCounts::n_events; ++i)
+    if (counts.available[i])
+      state.counters[PerfCounts::names[i]] = counts.values[i] / double(iterations * n);
+}
+
+// C = C - A / (2 * B), with the operands stored according to 'layout'.
+template <class T, std::size_t dims, Layout layout>
+static void BM_Evaluation(benchmark::State& state) {
+  setNumThreads(state.range(1));
+  const auto shape = cubeShape<dims>(state.range(0));
+  const std::size_t n = product(shape);
+
+  if constexpr (layout == Layout::contiguous) {
+    auto A = randomArray<T>(shape), B = randomArray<T>(shape), C = randomArray<T>(shape);
+    run<T>(
+        state, n, 4,
+        [&] {
+          C = C - A / (T(2) * B);
+          benchmark::DoNotOptimize(C.data());
+        },
+        [&] {
+          T* c = C.data();
+          const T *a = A.data(), *b = B.data();
+          for (std::size_t i = 0; i < n; ++i)
+            c[i] = c[i] - a[i] / (T(2) * b[i]);
+          benchmark::DoNotOptimize(c);
+        });
+  }
+  else if constexpr (layout == Layout::strided) {
+    // Every other element of arrays with a trailing axis of size 2.
+    std::array<std::size_t, dims + 1> padded;
+    std::copy(shape.begin(), shape.end(), padded.begin());
+    padded.back() = 2;
+    auto A = randomArray<T>(padded), B = randomArray<T>(padded), C = randomArray<T>(padded);
+    auto strided = [](auto& arr) {
+      return [&]<std::size_t... i>(std::index_sequence<i...>) {
+        return arr(((void)i, all)..., 0);
+      }(std::make_index_sequence<dims>());
+    };
+    auto a = strided(A), b = strided(B), c = strided(C);
+    NDArray<T, dims> result(shape);
+    run<T>(
+        state, n, 4,
+        [&] {
+          result = c - a / (T(2) * b);
+          benchmark::DoNotOptimize(result.data());
+        },
+        [&] {
+          T* r = result.data();
+          const T *pa = A.data(), *pb = B.data(), *pc = C.data();
+          for (std::size_t i = 0; i < n; ++i)
+            r[i] = pc[2 * i] - pa[2 * i] / (T(2) * pb[2 * i]);
+          benchmark::DoNotOptimize(r);
+        });
+  }
+  else {
+    // A is constant along the first axis, B along the last one.
+    auto shape_a = shape, shape_b = shape;
+    shape_a.front() = 1;
+    if constexpr (dims > 1)
+      shape_b.back() = 1;
+    auto A = randomArray<T>(shape_a), B = randomArray<T>(shape_b), C = randomArray<T>(shape);
+    const std::size_t a_size = A.size();
+    const std::size_t last = dims > 1 ? shape.back() : 1;
+    run<T>(
+        state, n, 4,
+        [&] {
+          C = C - A / (T(2) * B);
+          benchmark::DoNotOptimize(C.data());
+        },
+        [&] {
+          T* c = C.data();
+          const T *a = A.data(), *b = B.data();
+          for (std::size_t i = 0; i < n; ++i)
+            c[i] = c[i] - a[i % a_size] / (T(2) * b[i / last]);
+          benchmark::DoNotOptimize(c);
+        });
+  }
+}
+
+// Sizes from L1 resident to DRAM resident, with one thread and with every hardware thread.
+static void sweep(benchmark::internal::Benchmark* b) {
+  std::vector<long> thread_counts{1};
+  if (std::thread::hardware_concurrency() > 1)
+    thread_counts.push_back(std::thread::hardware_concurrency());
+  for (long threads : thread_counts)
+    for (long elements = 1 << 10; elements <= 1 << 24; elements *= 16)
+      b->Args({elements, threads});
+  b->ArgNames({"elements", "threads"});
+  b->UseRealTime();
+}
+
+#define NDARRAY_EVALUATION_BENCHMARKS(T, dims)                                                   \
+  BENCHMARK_TEMPLATE(BM_Evaluation, T, dims, Layout::contiguous)->Apply(sweep);                 \
+  BENCHMARK_TEMPLATE(BM_Evaluation, T, dims, Layout::strided)->Apply(sweep);                    \
+  BENCHMARK_TEMPLATE(BM_Evaluation, T, dims, Layout::broadcast)->Apply(sweep)
+
+NDARRAY_EVALUATION_BENCHMARKS(float, 1);
+NDARRAY_EVALUATION_BENCHMARKS(float, 3);
+NDARRAY_EVALUATION_BENCHMARKS(double, 1);
+NDARRAY_EVALUATION_BENCHMARKS(double, 3);
@@ -12,6 +12,8 @@
 
 #include <benchmark/benchmark.h>
 
+#include <random>
+
 constexpr std::size_t n = 50;
 using namespace nd;
 
@@ -27,6 +29,33 @@ static void BM_ContiguousLazyEvaluation(benchmark::State& state) {
 }
 BENCHMARK(BM_ContiguousLazyEvaluation);
 
+// Same expression evaluated in single precision.
+static void BM_ContiguousPinnedEvaluation(benchmark::State& state) {
+  nd::seed(0);
+  auto A = rand<float>(n, n, n);
+  auto B = rand<float>(n, n, n);
+  auto C = rand<float>(n, n, n);
+
+  for (auto _ : state) {
+    C = nd::as<float>(C - A / (2. * B));
+  }
+}
+BENCHMARK(BM_ContiguousPinnedEvaluation);
+
+// Boltzmann weights with the standard library exponential and with its vectorized approximation.
+template <Precision precision>
+static void BM_BoltzmannWeights(benchmark::State& state) {
+  nd::seed(0);
+  auto E = rand<float>(n, n, n);
+  NDArray<float, 3> W(n, n, n);
+
+  for (auto _ : state) {
+    W = nd::exp<precision>(-2.f * E);
+  }
+}
+BENCHMARK_TEMPLATE(BM_BoltzmannWeights, Precision::accurate);
+BENCHMARK_TEMPLATE(BM_BoltzmannWeights, Precision::fast);
+
 static void BM_ContiguousBaselineEvaluation(benchmark::State& state) {
   std::mt19937_64 rng(0);
   std::uniform_real_distribution<float> distro(0, 1);
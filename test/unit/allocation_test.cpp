@@ -0,0 +1,56 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the allocation policy of arrays.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace nd;
+
+TEST(AllocationTest, LargeArrays) {
+  setNumThreads(4);
+  NDArray<double, 2> a(1000, 1000);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(a.data()) % (1 << 21), 0);
+  EXPECT_TRUE(std::all_of(a.begin(), a.end(), [](double x) { return x == 0; }));
+
+  a = 2;
+  NDArray<double, 2> b = a;
+  EXPECT_TRUE(std::all_of(b.begin(), b.end(), [](double x) { return x == 2; }));
+
+  NDArray<double, 2> c = a * b + 1.;
+  EXPECT_TRUE(std::all_of(c.begin(), c.end(), [](double x) { return x == 5; }));
+
+  // Growth keeps the old elements and initializes the new ones.
+  NDArray<int, 1> d{1, 2, 3};
+  d.reshape(1 << 20);
+  EXPECT_EQ(d(2), 3);
+  EXPECT_TRUE(std::all_of(d.begin() + 3, d.end(), [](int x) { return x == 0; }));
+}
+
+TEST(AllocationTest, Policy) {
+  const AllocationPolicy default_policy = getAllocationPolicy();
+
+  AllocationPolicy policy;
+  policy.parallel_first_touch = false;
+  policy.huge_page_threshold = 0;
+  policy.numa_node = 0;
+  setAllocationPolicy(policy);
+  EXPECT_FALSE(getAllocationPolicy().parallel_first_touch);
+
+  NDArray<float, 3> a(100, 100, 100);
+  EXPECT_TRUE(std::all_of(a.begin(), a.end(), [](float x) { return x == 0; }));
+  a = 1;
+  NDArray<float, 3> b = a;
+  EXPECT_EQ(b(99, 99, 99), 1);
+
+  setAllocationPolicy(default_policy);
+}
@@ -0,0 +1,71 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the owning expressions and their asynchronous evaluation.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace nd;
+
+TEST(AsyncTest, Own) {
+  auto make = [] {
+    NDArray<int, 2> a{{1, 2}, {3, 4}};
+    NDArray<int, 1> b{10, 20};
+    return own(a * b + 1);  // Outlives 'a' and 'b'.
+  };
+  const auto expression = make();
+  static_assert(details::is_owning<std::decay_t<decltype(expression)>>);
+
+  NDArray<int, 2> c = expression;
+  EXPECT_EQ(c(0, 0), 11);
+  EXPECT_EQ(c(1, 1), 81);
+}
+
+TEST(AsyncTest, Share) {
+  auto a = std::make_shared<NDArray<double, 1>>(3);
+  *a = 2.;
+  const auto shared = share(a);
+  auto expression = shared * shared;
+  EXPECT_EQ(shared.useCount(), 4);
+
+  // Shared arrays are not copied.
+  auto owned = own(expression);
+  EXPECT_EQ(shared.useCount(), 6);
+
+  NDArray<double, 1> b = owned;
+  EXPECT_EQ(b[2], 4.);
+
+  const auto moved = share(NDArray<int, 1>{1, 2, 3});
+  NDArray<int, 1> c = moved(std::array<std::size_t, 1>{1}) * moved;
+  EXPECT_EQ(c[2], 6);
+}
+
+TEST(AsyncTest, Evaluation) {
+  NDArray<float, 2> a(100, 100), b(100, 100);
+  a = 1.f, b = 2.f;
+
+  std::vector<std::future<NDArray<float, 2>>> results;
+  for (int i = 0; i < 4; ++i)
+    results.push_back(asyncEval(a * float(i) + b));
+
+  // The operands are copied, and can be modified during the evaluation.
+  a = -1.f;
+
+  for (int i = 0; i < 4; ++i) {
+    const auto c = results[i].get();
+    EXPECT_EQ(c.shape(), a.shape());
+    for (float x : c)
+      EXPECT_EQ(x, float(i) + 2.f);
+  }
+
+  auto copy = asyncEval(b);
+  EXPECT_EQ(copy.get()(99, 99), 2.f);
+}
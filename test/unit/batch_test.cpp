@@ -0,0 +1,80 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the batched evaluation of assignments.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+using namespace nd;
+
+namespace {
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template <class T, std::size_t dims>
+void fill(NDArray<T, dims>& a, int seed) {
+  int i = 0;
+  for (auto& x : a)
+    x = T((i++ * 37 + seed) % 101) / 4;
+}
+}  // namespace
+
+TEST(BatchTest, Fusion) {
+  NDArray<double, 2> a(300, 200), b(300, 200), c(300, 200);
+  fill(a, 1);
+  fill(b, 2);
+  fill(c, 3);
+  NDArray<double, 2> e(300, 200), f(300, 200), g(300, 200);
+
+  Batch batch;
+  batch.assign(e, a + b);
+  batch.assign(f, a * c);
+  batch.assign(g, e * f + 1.);
+  // Elementwise dependencies do not prevent the fusion.
+  EXPECT_EQ(batch.groups(), (std::vector<std::vector<std::size_t>>{{0, 1, 2}}));
+  batch.run();
+  EXPECT_EQ(batch.size(), 0);
+
+  EXPECT_TRUE(equal(e, NDArray<double, 2>(a + b)));
+  EXPECT_TRUE(equal(f, NDArray<double, 2>(a * c)));
+  EXPECT_TRUE(equal(g, NDArray<double, 2>((a + b) * (a * c) + 1.)));
+}
+
+TEST(BatchTest, Dependencies) {
+  NDArray<float, 2> a(200, 300), b(200, 300), row(1, 300);
+  fill(a, 4);
+  fill(b, 5);
+  fill(row, 6);
+  NDArray<float, 2> e, f, g, h;
+
+  const NDArray<float, 2> e_ref = a - b;
+  const NDArray<float, 2> f_ref = a * row;
+  NDArray<float, 2> g_ref = e_ref * 2.f;
+  const NDArray<float, 2> h_ref = g_ref(range{0, 100}, all) + f_ref(range{100, 200}, all);
+
+  batch([&](Batch& batch) {
+    batch.assign(e, a - b);
+    batch.assign(f, a * row);  // Broadcast: evaluated by its own traversal.
+    batch.assign(g, e * 2.f);
+    batch.assign(h, g(range{0, 100}, all) + f(range{100, 200}, all));
+    // Must not be fused before the broadcast, which reads 'a'.
+    batch.assign(a, 0.f);
+    EXPECT_EQ(batch.groups(), (std::vector<std::vector<std::size_t>>{{0, 2}, {1}, {3}, {4}}));
+  });
+
+  EXPECT_TRUE(equal(e, e_ref));
+  EXPECT_TRUE(equal(f, f_ref));
+  EXPECT_TRUE(equal(g, g_ref));
+  EXPECT_TRUE(equal(h, h_ref));
+  EXPECT_TRUE(std::all_of(a.begin(), a.end(), [](float x) { return x == 0; }));
+}
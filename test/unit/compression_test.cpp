@@ -0,0 +1,85 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the compressed array files.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+using namespace nd;
+
+namespace {
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+}  // namespace
+
+TEST(CompressionTest, Codec) {
+  std::vector<std::uint8_t> data(10000);
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = (i / 7) % 5 + (i % 997 == 0);
+
+  const auto compressed = details::lzCompress(data.data(), data.size());
+  EXPECT_LT(compressed.size(), data.size() / 4);
+  std::vector<std::uint8_t> decompressed(data.size());
+  details::lzDecompress(compressed.data(), compressed.size(), decompressed.data(),
+                        decompressed.size());
+  EXPECT_EQ(decompressed, data);
+
+  EXPECT_THROW(details::lzDecompress(compressed.data(), compressed.size() / 2,
+                                     decompressed.data(), decompressed.size()),
+               std::runtime_error);
+}
+
+TEST(CompressionTest, SmoothField) {
+  NDArray<float, 3> field(20, 30, 40);
+  for (std::size_t i = 0; i < 20; ++i)
+    for (std::size_t j = 0; j < 30; ++j)
+      for (std::size_t k = 0; k < 40; ++k)
+        field(i, j, k) = std::round(1000 * std::sin(0.1 * i) * std::cos(0.05 * j + 0.02 * k)) / 8;
+
+  std::stringstream stream;
+  // Small chunks, to test the parallel encoding.
+  saveCompressed(stream, field, 4096);
+  EXPECT_LT(stream.str().size(), field.size() * sizeof(float) / 2);
+
+  const auto loaded = loadCompressed<float, 3>(stream);
+  EXPECT_TRUE(equal(loaded, field));
+
+  std::stringstream wrong(stream.str());
+  EXPECT_THROW((loadCompressed<double, 3>(wrong)), std::runtime_error);
+}
+
+TEST(CompressionTest, File) {
+  // Incompressible data is stored raw, column major order is preserved.
+  NDArray<std::uint32_t, 2> a({50, 70}, layout::left);
+  std::uint32_t state = 12345;
+  for (auto& x : a) {
+    state = state * 1664525u + 1013904223u;
+    x = state;
+  }
+
+  const auto path = std::filesystem::temp_directory_path() / "ndarray_compression_test.ndz";
+  saveCompressed(path, a);
+  const auto loaded = loadCompressed<std::uint32_t, 2>(path);
+  std::filesystem::remove(path);
+
+  EXPECT_EQ(loaded.order(), a.order());
+  EXPECT_TRUE(equal(loaded, a));
+
+  std::stringstream empty;
+  saveCompressed(empty, NDArray<double, 1>(0));
+  EXPECT_EQ((loadCompressed<double, 1>(empty).size()), 0);
+}
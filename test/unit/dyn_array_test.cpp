@@ -0,0 +1,80 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the arrays of runtime rank.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+
+using namespace nd;
+
+TEST(DynArrayTest, Views) {
+  DynArray<int> a({2, 3, 4});
+  EXPECT_EQ(a.rank(), 3);
+  EXPECT_EQ(a.size(), 24);
+  for (std::size_t i = 0; i < a.size(); ++i)
+    a[i] = i;
+  EXPECT_EQ(a({1, 2, 3}), 23);
+
+  NDView<int, 3> view = a;
+  EXPECT_EQ(view.data(), a.data());
+  EXPECT_EQ(view(1, 0, 2), 14);
+  view(0, 1, 1) = -1;
+  EXPECT_EQ(a[5], -1);
+
+  const NDArray<float, 2> fixed{{1, 2}, {3, 4}};
+  const DynArray<float> b = fixed;
+  EXPECT_EQ(b.shape(), (std::vector<std::size_t>{2, 2}));
+  EXPECT_EQ(b({1, 0}), 3);
+}
+
+TEST(DynArrayTest, Expressions) {
+  DynArray<double> a({3, 4});
+  DynArray<double> b({3, 4});
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    a[i] = i;
+    b[i] = 2. * i + 1;
+  }
+
+  const DynArray c = a * b + 2.;
+  static_assert(std::is_same_v<decltype(c), const DynArray<double>>);
+  EXPECT_EQ(c.shape(), a.shape());
+  for (std::size_t i = 0; i < c.size(); ++i)
+    EXPECT_EQ(c[i], a[i] * b[i] + 2.);
+
+  // Broadcast of a singleton axis of the same rank.
+  DynArray<double> row({1, 4});
+  row = 10.;
+  const DynArray<double> d = a - row / 2.;
+  EXPECT_EQ(d({2, 3}), 11. - 5.);
+
+  // In place update.
+  a = a * 2.;
+  EXPECT_EQ(a({1, 1}), 10.);
+
+  const DynArray<double> other({12});
+  EXPECT_THROW(DynArray<double>(a + other), std::invalid_argument);
+}
+
+TEST(DynArrayTest, Dispatch) {
+  DynArray<double> a({2, 2, 2});
+  for (std::size_t i = 0; i < a.size(); ++i)
+    a[i] = i;
+
+  const double norm = dispatch([](const auto& x) { return nd::sum(x * x); }, a);
+  EXPECT_EQ(norm, 140.);
+
+  std::size_t rank = 0;
+  dispatch([&](auto x) { rank = decltype(x)::dimensions; }, a);
+  EXPECT_EQ(rank, 3);
+
+  const DynArray<double> b = dispatch([](auto x) { return x + 1.; }, a);
+  EXPECT_EQ(b({1, 1, 1}), 8.);
+}
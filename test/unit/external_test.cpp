@@ -0,0 +1,104 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the views of external memory and the DLPack exchange.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace nd;
+
+TEST(ExternalTest, MakeView) {
+  std::vector<double> buffer(12);
+  for (std::size_t i = 0; i < buffer.size(); ++i)
+    buffer[i] = i;
+
+  auto view = makeView(buffer.data(), std::array<std::size_t, 2>{3, 4});
+  EXPECT_EQ(view(1, 2), 6);
+  view(2, 3) = -1;
+  EXPECT_EQ(buffer[11], -1);
+
+  const auto fortran = makeView(buffer.data(), std::array<std::size_t, 2>{3, 4}, layout::left);
+  EXPECT_EQ(fortran(1, 2), 7);
+
+  // Every other column.
+  NDView<double, 2> strided(buffer.data(), {3, 2}, {4, 2});
+  EXPECT_EQ(strided(2, 1), 10);
+
+  // External memory is the target of expressions.
+  view = view * 2.;
+  EXPECT_EQ(buffer[5], 10);
+  NDArray<double, 2> copy = strided + 1.;
+  EXPECT_EQ(copy(1, 1), 13);
+}
+
+#ifdef __cpp_lib_mdspan
+TEST(ExternalTest, Mdspan) {
+  NDArray<int, 2> a{{1, 2, 3}, {4, 5, 6}};
+  const auto span = toMdspan(NDView<int, 2>(a));
+  EXPECT_EQ((span[1, 2]), 6);
+  const auto view = makeView(span);
+  EXPECT_EQ(view(1, 0), 4);
+}
+#endif
+
+TEST(ExternalTest, DLPackRoundTrip) {
+  NDArray<float, 3> a(2, 3, 4);
+  float value = 0;
+  for (auto& x : a)
+    x = value++;
+  const float* const data = a.data();
+
+  DLManagedTensor* tensor = toDLPack(std::move(a));
+  EXPECT_EQ(tensor->dl_tensor.ndim, 3);
+  EXPECT_EQ(tensor->dl_tensor.dtype.code, kDLFloat);
+  EXPECT_EQ(tensor->dl_tensor.dtype.bits, 32);
+  EXPECT_EQ(tensor->dl_tensor.strides[0], 12);
+  EXPECT_EQ(tensor->dl_tensor.data, data);
+
+  const DLPackView<float, 3> imported(tensor);
+  EXPECT_EQ(imported.view().data(), data);
+  EXPECT_EQ(imported.view()(1, 2, 3), 23);
+  NDArray<float, 3> b = imported.view() * 2.f;
+  EXPECT_EQ(b(1, 0, 1), 2 * 13);
+}
+
+TEST(ExternalTest, DLPackImport) {
+  // Tensor produced by another library, column major and without explicit strides.
+  static bool deleted;
+  deleted = false;
+  std::vector<std::int64_t> values{1, 2, 3, 4, 5, 6};
+  std::int64_t shape[2] = {3, 2};
+  std::int64_t strides[2] = {1, 3};
+  DLManagedTensor tensor{};
+  tensor.dl_tensor = {values.data(), {kDLCPU, 0}, 2, {kDLInt, 64, 1}, shape, strides, 0};
+  tensor.deleter = [](DLManagedTensor*) { deleted = true; };
+
+  {
+    DLPackView<std::int64_t, 2> view(&tensor);
+    EXPECT_EQ(view.view()(2, 1), 6);
+    EXPECT_EQ(view.view()(1, 0), 2);
+    DLPackView<std::int64_t, 2> moved(std::move(view));
+    EXPECT_FALSE(deleted);
+  }
+  EXPECT_TRUE(deleted);
+
+  tensor.dl_tensor.strides = nullptr;
+  tensor.dl_tensor.byte_offset = sizeof(std::int64_t);
+  tensor.dl_tensor.shape[0] = 1;
+  {
+    DLPackView<std::int64_t, 2> view(&tensor);
+    EXPECT_EQ(view.view()(0, 1), 3);
+  }
+
+  deleted = false;
+  EXPECT_THROW((DLPackView<double, 2>(&tensor)), std::invalid_argument);
+  EXPECT_TRUE(deleted);
+}
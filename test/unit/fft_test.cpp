@@ -0,0 +1,127 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the Fourier transforms along an axis.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <complex>
+#include <numbers>
+
+using namespace nd;
+using Complex = std::complex<double>;
+
+// Quadratic reference transform of a single fibre.
+std::vector<Complex> referenceDft(const std::vector<Complex>& x) {
+  const std::size_t n = x.size();
+  std::vector<Complex> result(n);
+  for (std::size_t k = 0; k < n; ++k)
+    for (std::size_t j = 0; j < n; ++j)
+      result[k] += x[j] * std::polar(1., -2 * std::numbers::pi * double(j * k % n) / n);
+  return result;
+}
+
+NDArray<Complex, 3> makeInput(std::size_t n0, std::size_t n1, std::size_t n2) {
+  NDArray<Complex, 3> x(n0, n1, n2);
+  broadcastIndex(
+      [](Complex& v, const auto& index) {
+        v = Complex(std::sin(1. + index[0] + 3. * index[1] + 7. * index[2]),
+                    std::cos(2. * index[0] + index[1] + 5. * index[2]));
+      },
+      x);
+  return x;
+}
+
+// Compares each fibre of 'result' along 'axis' with the reference transform of 'input'.
+void checkAxis(const NDArray<Complex, 3>& input, const NDArray<Complex, 3>& result,
+               std::size_t axis) {
+  const auto& shape = input.shape();
+  const std::size_t n = shape[axis];
+  broadcastShape(
+      [&](auto index) {
+        if (index[axis] != 0)
+          return;
+        std::vector<Complex> fibre(n);
+        for (std::size_t k = 0; k < n; ++k, ++index[axis])
+          fibre[k] = input(index);
+        const auto expected = referenceDft(fibre);
+        index[axis] = 0;
+        for (std::size_t k = 0; k < n; ++k, ++index[axis])
+          EXPECT_NEAR(std::abs(result(index) - expected[k]), 0, 1e-9 * n);
+      },
+      shape);
+}
+
+TEST(FFTTest, Lengths) {
+  for (std::size_t n : {1, 2, 3, 4, 5, 7, 8, 12, 16, 17, 30, 60, 64, 97, 128, 210}) {
+    const auto x = makeInput(1, 1, n);
+    auto y = x;
+    fft(y);
+    checkAxis(x, y, 2);
+  }
+}
+
+TEST(FFTTest, Axes) {
+  setNumThreads(4);
+  const auto x = makeInput(12, 20, 9);
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    auto y = x;
+    fft(y, axis);
+    checkAxis(x, y, axis);
+
+    ifft(y, axis);
+    for (std::size_t i = 0; i < x.length(); ++i)
+      EXPECT_NEAR(std::abs(y[i] - x[i]), 0, 1e-12);
+  }
+}
+
+TEST(FFTTest, View) {
+  const auto x = makeInput(8, 10, 6);
+  auto y = x;
+  fft(y(range{2, 6}, all, 3), 0);
+
+  broadcastIndex(
+      [&](const Complex& v, const auto& index) {
+        if (index[0] >= 2 && index[0] < 6 && index[2] == 3)
+          return;
+        EXPECT_EQ(v, x(index));
+      },
+      y);
+
+  NDArray<Complex, 3> sub(4, 10, 1), sub_result(4, 10, 1);
+  broadcastIndex(
+      [&](Complex& v, const auto& index) {
+        v = x(index[0] + 2, index[1], 3);
+        sub_result(index) = y(index[0] + 2, index[1], 3);
+      },
+      sub);
+  checkAxis(sub, sub_result, 0);
+}
+
+TEST(FFTTest, Real) {
+  setNumThreads(4);
+  NDArray<double, 2> x(7, 12);
+  broadcastIndex([](double& v, const auto& index) { v = std::sin(index[0] * 3. + index[1]); }, x);
+
+  for (std::size_t axis = 0; axis < 2; ++axis) {
+    const std::size_t n = x.shape()[axis];
+    const auto spectrum = rfft(x, axis);
+    EXPECT_EQ(spectrum.shape()[axis], n / 2 + 1);
+
+    NDArray<Complex, 2> full(x.shape());
+    broadcastIndex([&](Complex& v, const auto& index) { v = x(index); }, full);
+    fft(full, axis);
+    broadcastIndex(
+        [&](const Complex& v, const auto& index) {
+          EXPECT_NEAR(std::abs(v - full(index)), 0, 1e-10);
+        },
+        spectrum);
+  }
+}
@@ -0,0 +1,132 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the selection of elements through arrays of indices.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+
+using namespace nd;
+TEST(IndexedViewTest, Take) {
+  NDArray<int, 3> A(4, 3, 5);
+  std::iota(A.begin(), A.end(), 0);
+  NDArray<int, 1> idx{2, 0, -1, 2};
+
+  NDArray<int, 3> rows = take(A, idx);
+  EXPECT_EQ(rows.shape(), (std::array<std::size_t, 3>{4, 3, 5}));
+  NDArray<int, 3> cols = take(A, idx, 2);
+  EXPECT_EQ(cols.shape(), (std::array<std::size_t, 3>{4, 3, 4}));
+
+  const int expected_rows[] = {2, 0, 3, 2};
+  const int expected_cols[] = {2, 0, 4, 2};
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 3; ++j)
+      for (int k = 0; k < 4; ++k) {
+        EXPECT_EQ(rows(i, j, k), A(expected_rows[i], j, k));
+        EXPECT_EQ(cols(k, j, i), A(k, j, expected_cols[i]));
+      }
+}
+
+TEST(IndexedViewTest, CallOperator) {
+  NDArray<int, 3> A(4, 3, 5);
+  std::iota(A.begin(), A.end(), 0);
+  NDArray<long, 1> idx{1, 3};
+
+  auto gathered = makeTensor(A(-1, all, idx));
+  EXPECT_EQ(gathered.shape(), (std::array<std::size_t, 2>{3, 2}));
+  for (int j = 0; j < 3; ++j) {
+    EXPECT_EQ(gathered(j, 0), A(3, j, 1));
+    EXPECT_EQ(gathered(j, 1), A(3, j, 3));
+  }
+
+  const auto& const_A = A;
+  NDArray<int, 4> with_axis = const_A(idx(range{0, 1}), newaxis, range{1, end}, all);
+  EXPECT_EQ(with_axis.shape(), (std::array<std::size_t, 4>{1, 1, 2, 5}));
+  EXPECT_EQ(with_axis(0, 0, 1, 4), A(1, 2, 4));
+}
+
+TEST(IndexedViewTest, LazyEvaluation) {
+  NDArray<double, 2> A(5, 3), B(2, 3);
+  std::iota(A.begin(), A.end(), 0);
+  B = 1;
+  NDArray<int, 1> idx{4, 1};
+
+  NDArray<double, 2> C = 2. * A(idx, all) + B;
+  for (int j = 0; j < 3; ++j) {
+    EXPECT_EQ(C(0, j), 2. * A(4, j) + 1);
+    EXPECT_EQ(C(1, j), 2. * A(1, j) + 1);
+  }
+
+  // Broadcast against a row.
+  C = A(idx, all) - A(0, all);
+  EXPECT_EQ(C(0, 2), A(4, 2) - A(0, 2));
+}
+
+TEST(IndexedViewTest, Scatter) {
+  auto A = zeros<int>(4, 3);
+  NDArray<int, 1> idx{3, 1};
+
+  A(idx, all) = 7;
+  EXPECT_EQ(A(1, 0), 7);
+  EXPECT_EQ(A(3, 2), 7);
+  EXPECT_EQ(A(0, 0), 0);
+
+  NDArray<int, 2> values{{1, 2, 3}, {4, 5, 6}};
+  put(A, idx, values);
+  EXPECT_EQ(A(3, 0), 1);
+  EXPECT_EQ(A(1, 2), 6);
+
+  take(A, idx, 0) = values * 2;
+  EXPECT_EQ(A(3, 1), 4);
+  EXPECT_EQ(A(1, 0), 8);
+
+  // Broadcast a row to every selected column.
+  NDArray<int, 1> cols{0, 2};
+  A(all, cols) = values(0, range{0, 2})(newaxis, all);
+  EXPECT_EQ(A(2, 0), 1);
+  EXPECT_EQ(A(2, 2), 2);
+  EXPECT_EQ(A(2, 1), 0);
+}
+
+TEST(IndexedViewTest, Permutation) {
+  NDArray<int, 2> A(6, 2);
+  std::iota(A.begin(), A.end(), 0);
+  const auto original = A;
+  NDArray<int, 1> perm{5, 4, 3, 2, 1, 0};
+
+  // The source is read before being overwritten.
+  A = A(perm, all);
+  for (int i = 0; i < 6; ++i)
+    for (int j = 0; j < 2; ++j)
+      EXPECT_EQ(A(i, j), original(5 - i, j));
+
+  A(all, 0) = original(perm, 1);
+  for (int i = 0; i < 6; ++i)
+    EXPECT_EQ(A(i, 0), original(5 - i, 1));
+}
+
+TEST(IndexedViewTest, ParallelGather) {
+  setNumThreads(4);
+
+  NDArray<float, 2> A(1000, 100);
+  std::iota(A.begin(), A.end(), 0);
+  NDArray<std::size_t, 1> idx(2000);
+  for (std::size_t i = 0; i < idx.size(); ++i)
+    idx[i] = (i * 7919) % 1000;
+
+  NDArray<float, 2> B = A(idx, all);
+  NDArray<float, 2> C = take(A(all, range{0, 50}), idx, 0);
+  for (std::size_t i = 0; i < idx.size(); ++i) {
+    EXPECT_EQ(B(i, 99), A(idx[i], 99));
+    EXPECT_EQ(C(i, 49), A(idx[i], 49));
+  }
+
+  setNumThreads(1);
+}
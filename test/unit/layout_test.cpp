@@ -0,0 +1,88 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the arrays with column major and permuted axis orders.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace nd;
+
+TEST(LayoutTest, Strides) {
+  NDArray<int, 3> a({2, 3, 4}, layout::left);
+  EXPECT_EQ(a.order(), (AxisOrder<3>{2, 1, 0}));
+  EXPECT_EQ((NDView<int, 3>(a).strides()), (std::array<std::size_t, 3>{1, 2, 6}));
+
+  a(1, 2, 3) = 1;
+  EXPECT_EQ(a.data()[1 + 2 * 2 + 3 * 6], 1);
+
+  NDArray<int, 3> b({2, 3, 4}, AxisOrder<3>{1, 2, 0});
+  EXPECT_EQ((NDView<int, 3>(b).strides()), (std::array<std::size_t, 3>{1, 8, 2}));
+
+  // Views and reshapes follow the order.
+  auto row = a(1, all, all);
+  EXPECT_EQ(row(2, 3), 1);
+  a.reshape(4, 3, 2);
+  EXPECT_EQ((NDView<int, 3>(a).strides()), (std::array<std::size_t, 3>{1, 4, 12}));
+}
+
+TEST(LayoutTest, Conversion) {
+  NDArray<int, 2> a{{1, 2, 3}, {4, 5, 6}};
+  const auto f = a.reordered(layout::left);
+  EXPECT_EQ(f.order(), (AxisOrder<2>(layout::left)));
+  const std::vector<int> expected{1, 4, 2, 5, 3, 6};
+  EXPECT_TRUE(std::equal(f.begin(), f.end(), expected.begin()));
+
+  const auto c = f.reordered(layout::right);
+  EXPECT_TRUE(std::equal(c.begin(), c.end(), a.begin()));
+
+  NDArray<int, 2> copy = f;
+  EXPECT_EQ(copy.order(), f.order());
+  EXPECT_EQ(copy(1, 0), 4);
+}
+
+TEST(LayoutTest, Evaluation) {
+  NDArray<double, 2> a({5, 7}, layout::left), b({5, 7}, layout::left);
+  NDArray<double, 2> r(5, 7);
+  for (std::size_t i = 0; i < 5; ++i)
+    for (std::size_t j = 0; j < 7; ++j) {
+      a(i, j) = i + 10 * j;
+      b(i, j) = 1 + j;
+      r(i, j) = 2 * i;
+    }
+
+  // Same order: linear evaluation, keeping the order.
+  NDArray<double, 2> c = a - a / (2. * b);
+  EXPECT_EQ(c.order(), a.order());
+  EXPECT_EQ(c(3, 4), 43 - 43 / 10.);
+
+  // Mixed orders.
+  NDArray<double, 2> d = a + r;
+  EXPECT_EQ(d.order(), a.order());
+  EXPECT_EQ(d(3, 4), 43 + 6);
+  NDArray<double, 2> e = r + a;
+  EXPECT_TRUE(details::isRowMajor(e.order()));
+  EXPECT_EQ(e(3, 4), 43 + 6);
+
+  // Assignment keeps the order of the destination.
+  r = a * 2.;
+  EXPECT_TRUE(details::isRowMajor(r.order()));
+  EXPECT_EQ(r(4, 6), 2 * 64);
+  c = r + 1.;
+  EXPECT_EQ(c.order(), a.order());
+  EXPECT_EQ(c(4, 6), 129);
+
+  // Broadcasting.
+  NDArray<double, 1> v{1, 2, 3, 4, 5, 6, 7};
+  c = a * v;
+  EXPECT_EQ(c(2, 3), 32 * 4);
+
+  EXPECT_EQ(sum(a), sum(a.reordered(layout::right)));
+  const auto scanned = cumsum(a, 1);
+  EXPECT_EQ(scanned(1, 2), 1 + 11 + 21);
+}
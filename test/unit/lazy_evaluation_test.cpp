@@ -137,3 +137,39 @@ TEST(LazyEvaluationTest, DanglingFunction) {
 
   EXPECT_EQ(C[0], 3);
 }
+
+TEST(LazyEvaluationTest, BroadcastFirstOperand) {
+  NDArray<int, 2> A{{1, 2, 3}};
+  NDArray<int, 2> B{{10, 20, 30}, {40, 50, 60}};
+
+  NDArray<int, 2> C = A + B;
+  EXPECT_EQ(C(1, 2), 63);
+
+  NDArray<int, 4> AB = A(all, all, newaxis, newaxis) * B;
+  EXPECT_EQ(AB.shape(), (std::array<std::size_t, 4>{1, 3, 2, 3}));
+  EXPECT_EQ(AB(0, 2, 1, 0), 3 * 40);
+}
+
+TEST(LazyEvaluationTest, ComputeType) {
+  NDArray<float, 1> A{1.f, 2.f, 3.f};
+  NDArray<double, 1> B{0.5, 0.25, 0.125};
+
+  auto promoted = makeTensor(2. * A);
+  static_assert(std::is_same_v<decltype(promoted), NDArray<double, 1>>);
+
+  // Every operation, scalar and array of a different type is converted to float.
+  auto pinned = makeTensor(nd::as<float>(2. * A + B));
+  static_assert(std::is_same_v<decltype(pinned), NDArray<float, 1>>);
+  for (std::size_t i = 0; i < 3; ++i)
+    EXPECT_EQ(pinned[i], 2.f * A[i] + float(B[i]));
+
+  // Masks are left boolean.
+  auto selected = makeTensor(nd::as<int>(where(A > 1.5, A * 1.5, B)));
+  static_assert(std::is_same_v<decltype(selected), NDArray<int, 1>>);
+  EXPECT_EQ(selected[0], 0);
+  EXPECT_EQ(selected[1], 2);  // 1.5 is converted to 1.
+
+  // Arrays of the pinned type are referenced, not copied.
+  const auto& same = nd::as<float>(A);
+  EXPECT_EQ(&same, &A);
+}
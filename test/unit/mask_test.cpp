@@ -0,0 +1,117 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests comparisons, boolean masks and the selection of elements through them.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+
+using namespace nd;
+TEST(MaskTest, Comparisons) {
+  NDArray<int, 2> A{{1, 5}, {3, 0}};
+  NDArray<int, 2> B{{2, 5}, {1, 1}};
+
+  NDArray<bool, 2> less = A < B;
+  EXPECT_EQ(less.shape(), A.shape());
+  EXPECT_TRUE(less(0, 0));
+  EXPECT_FALSE(less(0, 1));
+  EXPECT_FALSE(less(1, 0));
+  EXPECT_TRUE(less(1, 1));
+
+  auto equal = makeTensor(A == B);
+  static_assert(std::is_same_v<decltype(equal)::value_type, bool>);
+  EXPECT_TRUE(equal(0, 1));
+  EXPECT_EQ(std::count(equal.begin(), equal.end(), true), 1);
+
+  auto combined = makeTensor((A >= 1) & (A != 5) | !less);
+  EXPECT_TRUE(combined(0, 0));
+  EXPECT_TRUE(combined(0, 1));
+  EXPECT_TRUE(combined(1, 0));
+  EXPECT_FALSE(combined(1, 1));
+}
+
+TEST(MaskTest, Where) {
+  NDArray<double, 2> A(3, 4);
+  std::iota(A.begin(), A.end(), -6.);
+
+  // Clamp to [-2, 2] and scale the negative part of a strided view.
+  NDArray<double, 2> clamped = where(A < -2, -2, where(A > 2, 2., A));
+  NDArray<double, 1> row = where(A(all, 1) < 0, 0.5 * A(all, 1), A(all, 1));
+
+  for (std::size_t i = 0; i < A.size(); ++i)
+    EXPECT_EQ(clamped[i], std::clamp(A[i], -2., 2.));
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ(row(i), A(i, 1) < 0 ? 0.5 * A(i, 1) : A(i, 1));
+}
+
+TEST(MaskTest, MaskedAssignment) {
+  NDArray<int, 2> A(4, 5);
+  std::iota(A.begin(), A.end(), -10);
+  const auto original = A;
+
+  A(A > 3) = 3;
+  A(A < 0) = -1 * A;
+  for (std::size_t i = 0; i < A.size(); ++i)
+    EXPECT_EQ(A[i], original[i] < 0 ? -original[i] : std::min(original[i], 3));
+
+  // Assign to a strided view, broadcasting the right hand side.
+  auto col = A(all, 2);
+  NDArray<bool, 1> mask{true, false, true, false};
+  col(mask) = 42;
+  EXPECT_EQ(A(0, 2), 42);
+  EXPECT_EQ(A(1, 2), original(1, 2) < 0 ? -original(1, 2) : std::min(original(1, 2), 3));
+  EXPECT_EQ(A(2, 2), 42);
+  EXPECT_EQ(col(mask).count(), 2);
+
+  NDArray<int, 2> B(4, 5);
+  B = 0;
+  B(original > 0) = original(0, all);
+  EXPECT_EQ(B(3, 4), original(0, 4));
+  EXPECT_EQ(B(0, 4), 0);
+}
+
+TEST(MaskTest, Compress) {
+  NDArray<int, 2> A(3, 4);
+  std::iota(A.begin(), A.end(), 0);
+
+  auto even = compress((A & 1) == 0, A);
+  ASSERT_EQ(even.shape(), (std::array<std::size_t, 1>{6}));
+  for (int i = 0; i < 6; ++i)
+    EXPECT_EQ(even(i), 2 * i);
+
+  auto column = compress(A(all, 1) > 4, A(all, 1) * 10);
+  EXPECT_EQ(column.shape(), (std::array<std::size_t, 1>{2}));
+  EXPECT_EQ(column(0), 50);
+  EXPECT_EQ(column(1), 90);
+
+  EXPECT_EQ(compress(A < 0, A).size(), 0);
+}
+
+TEST(MaskTest, ParallelCompress) {
+  setNumThreads(4);
+
+  NDArray<float, 2> A(1000, 300);
+  std::iota(A.begin(), A.end(), 0);
+  auto selected = compress(A(all, range{0, 200}) > 1000.f, A(all, range{0, 200}));
+  auto contiguous = compress(A > 1000.f, A);
+
+  EXPECT_EQ(contiguous.size(), A.size() - 1001);
+  for (std::size_t i = 0; i < contiguous.size(); ++i)
+    EXPECT_EQ(contiguous[i], 1001 + i);
+
+  std::size_t k = 0;
+  for (int i = 0; i < 1000; ++i)
+    for (int j = 0; j < 200; ++j)
+      if (A(i, j) > 1000.f)
+        ASSERT_EQ(selected[k++], A(i, j));
+  EXPECT_EQ(k, selected.size());
+
+  setNumThreads(1);
+}
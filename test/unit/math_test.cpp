@@ -0,0 +1,128 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the elementary functions, and the accuracy of their fast approximations.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <limits>
+
+using namespace nd;
+
+// Distance between 'x' and 'reference' in units in the last place of 'reference'.
+template <class T>
+double ulps(T x, T reference) {
+  if (x == reference)
+    return 0;
+  const T magnitude = std::abs(reference);
+  const T ulp = std::nextafter(magnitude, std::numeric_limits<T>::infinity()) - magnitude;
+  return std::abs(double(x) - double(reference)) / double(ulp);
+}
+
+// Maximum error of 'fast' with respect to 'accurate' over 'x'.
+template <class T, std::size_t dims, class Fast, class Accurate>
+double maxError(const NDArray<T, dims>& x, Fast&& fast, Accurate&& accurate) {
+  NDArray<T, dims> result = fast(x);
+  NDArray<T, dims> reference = accurate(x);
+  double error = 0;
+  for (std::size_t i = 0; i < x.size(); ++i)
+    error = std::max(error, ulps(result[i], reference[i]));
+  return error;
+}
+
+template <class T>
+NDArray<T, 1> uniform(T min, T max, unsigned seed = 0) {
+  NDArray<T, 1> x(100000);
+  RandomEngine(seed).fill(x, Uniform<T>{min, max});
+  return x;
+}
+
+#define NDARRAY_FAST(name) [](const auto& x) { return nd::name<Precision::fast>(x); }
+#define NDARRAY_ACCURATE(name) [](const auto& x) { return nd::name(x); }
+
+template <class T>
+class MathTest : public ::testing::Test {};
+using FloatTypes = ::testing::Types<float, double>;
+TYPED_TEST_SUITE(MathTest, FloatTypes);
+
+TYPED_TEST(MathTest, Accuracy) {
+  using T = TypeParam;
+  const T max_exp = std::is_same_v<T, double> ? 709 : 88;
+  const T min_exp = std::is_same_v<T, double> ? -745 : -103;
+
+  EXPECT_LE(maxError(uniform<T>(min_exp, max_exp), NDARRAY_FAST(exp), NDARRAY_ACCURATE(exp)), 1);
+  EXPECT_LE(maxError(uniform<T>(-1, 1), NDARRAY_FAST(exp), NDARRAY_ACCURATE(exp)), 1);
+  EXPECT_LE(maxError(uniform<T>(0, 1e30), NDARRAY_FAST(log), NDARRAY_ACCURATE(log)), 3);
+  EXPECT_LE(maxError(uniform<T>(0.5, 2), NDARRAY_FAST(log), NDARRAY_ACCURATE(log)), 3);
+  EXPECT_LE(maxError(uniform<T>(-1e5, 1e5), NDARRAY_FAST(sin), NDARRAY_ACCURATE(sin)), 3);
+  EXPECT_LE(maxError(uniform<T>(-4, 4), NDARRAY_FAST(cos), NDARRAY_ACCURATE(cos)), 3);
+  EXPECT_LE(maxError(uniform<T>(-5, 5), NDARRAY_FAST(tanh), NDARRAY_ACCURATE(tanh)), 3);
+  EXPECT_LE(maxError(uniform<T>(-0.3, 0.3), NDARRAY_FAST(tanh), NDARRAY_ACCURATE(tanh)), 3);
+  EXPECT_LE(maxError(uniform<T>(-6, 6), NDARRAY_FAST(erf), NDARRAY_ACCURATE(erf)), 5);
+
+  // The error of double precision powers grows with |exponent * log(base)|.
+  auto fast_pow = [](const auto& x) { return nd::pow<Precision::fast>(x, T(2.5)); };
+  auto accurate_pow = [](const auto& x) { return nd::pow(x, T(2.5)); };
+  const double pow_tolerance = std::is_same_v<T, double> ? 1 + 6 * 2.5 * std::log(4.) : 1;
+  EXPECT_LE(maxError(uniform<T>(0, 4), fast_pow, accurate_pow), pow_tolerance);
+}
+
+TYPED_TEST(MathTest, SpecialValues) {
+  using T = TypeParam;
+  constexpr T inf = std::numeric_limits<T>::infinity();
+  constexpr T nan = std::numeric_limits<T>::quiet_NaN();
+  constexpr T denorm = std::numeric_limits<T>::denorm_min();
+  NDArray<T, 1> x{T(0), -T(0), T(1), -T(1), inf, -inf, nan, T(-2000), T(2000), denorm * 8};
+
+  NDArray<T, 1> exp = nd::exp<Precision::fast>(x);
+  NDArray<T, 1> log = nd::log<Precision::fast>(x);
+  NDArray<T, 1> tanh = nd::tanh<Precision::fast>(x);
+  NDArray<T, 1> erf = nd::erf<Precision::fast>(x);
+
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    auto check = [&](T fast, T accurate, double tolerance) {
+      if (std::isnan(accurate))
+        EXPECT_TRUE(std::isnan(fast)) << x[i];
+      else if (std::isinf(accurate))
+        EXPECT_EQ(fast, accurate) << x[i];
+      else
+        EXPECT_LE(ulps(fast, accurate), tolerance) << x[i];
+    };
+    check(exp[i], std::exp(x[i]), 1);
+    check(log[i], std::log(x[i]), 3);
+    check(tanh[i], std::tanh(x[i]), 3);
+    check(erf[i], std::erf(x[i]), 5);
+  }
+
+  // Subnormal results.
+  EXPECT_LE(ulps(details::fastExp(T(std::is_same_v<T, double> ? -740 : -100)),
+                 std::exp(T(std::is_same_v<T, double> ? -740 : -100))),
+            1);
+}
+
+TEST(MathTest, Types) {
+  NDArray<int, 1> n{1, 2, 3};
+  NDArray<float, 1> x{1, 2, 3};
+
+  // Integers are promoted like by the standard library.
+  auto a = makeTensor(nd::exp(n));
+  auto b = makeTensor(nd::exp<Precision::fast>(n));
+  auto c = makeTensor(nd::sin<Precision::fast>(x));
+  static_assert(std::is_same_v<decltype(a), NDArray<double, 1>>);
+  static_assert(std::is_same_v<decltype(b), NDArray<double, 1>>);
+  static_assert(std::is_same_v<decltype(c), NDArray<float, 1>>);
+  for (std::size_t i = 0; i < 3; ++i) {
+    EXPECT_DOUBLE_EQ(a[i], std::exp(n[i]));
+    EXPECT_DOUBLE_EQ(b[i], std::exp(n[i]));
+    EXPECT_FLOAT_EQ(c[i], std::sin(x[i]));
+  }
+
+  // Functions of scalars are evaluated immediately.
+  EXPECT_DOUBLE_EQ(nd::log(std::exp(2.)), 2.);
+}
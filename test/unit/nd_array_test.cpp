@@ -10,6 +10,7 @@
 #include "ndarray/nd_array.hpp"
 
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <ostream>
 
 using namespace nd;
@@ -128,8 +129,50 @@ TEST(NDArrayTest, InitFunctions) {
   auto r = rand<float>(1, 6, 3, 2);
   EXPECT_EQ(r.shape(), (std::array<std::size_t, 4>{1, 6, 3, 2}));
 
-  std::mt19937_64 rng(42);
-  std::uniform_real_distribution<float> distro(0, 1);
-  for (auto x : r)
-    EXPECT_EQ(distro(rng), x);
+  for (auto x : r) {
+    EXPECT_LE(0, x);
+    EXPECT_GT(1, x);
+  }
+
+  nd::seed(42);
+  auto r2 = rand<float>(1, 6, 3, 2);
+  EXPECT_TRUE(std::equal(r.begin(), r.end(), r2.begin()));
+}
+
+TEST(NDArrayTest, Append) {
+  NDArray<int, 2> a;
+  NDArray<int, 1> row{1, 2, 3};
+  a.append(row);
+  EXPECT_EQ(a.shape(), (std::array<std::size_t, 2>{1, 3}));
+
+  a.reserve(10);
+  EXPECT_EQ(a.capacity(), 10);
+  const int* const data = a.data();
+  a.append(row * 2);
+  a.append(NDArray<int, 1>(a(0, all)));
+  NDArray<int, 2> b{{7, 8, 9}, {10, 11, 12}};
+  a.append(b);
+  a.append(b(0, all) * 0 + 5);
+  EXPECT_EQ(a.data(), data);
+  EXPECT_EQ(a.shape(), (std::array<std::size_t, 2>{6, 3}));
+  EXPECT_EQ(a(1, 2), 6);
+  EXPECT_EQ(a(2, 0), 1);
+  EXPECT_EQ(a(4, 1), 11);
+  EXPECT_EQ(a(5, 1), 5);
+
+  // Geometric growth.
+  std::size_t reallocations = 0;
+  for (int i = 0; i < 1000; ++i) {
+    const int* const before = a.data();
+    a.append(row);
+    reallocations += a.data() != before;
+  }
+  EXPECT_LE(reallocations, 10);
+  EXPECT_EQ(a(1005, 2), 3);
+
+  NDArray<double, 1> v;
+  for (int i = 0; i < 5; ++i)
+    v.append(double(i));
+  EXPECT_EQ(v.shape()[0], 5);
+  EXPECT_EQ(v(4), 4.);
 }
@@ -0,0 +1,63 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the hardware counters. The counters may not be available, e.g. in a container, in which
+// case only the bookkeeping is tested.
+
+#define NDARRAY_PERF
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace nd;
+
+TEST(PerfCountersTest, Region) {
+  resetPerfReport();
+  NDArray<double, 1> a(1 << 16), b(1 << 16);
+  a = 1., b = 2.;
+
+  for (int i = 0; i < 3; ++i) {
+    PerfRegion region("update");
+    a = a + b;
+  }
+
+  const auto report = perfReport();
+  ASSERT_EQ(report.count("update"), 1);
+  const PerfRecord& record = report.at("update");
+  EXPECT_EQ(record.calls, 3);
+  for (std::size_t i = 0; i < PerfCounts::n_events; ++i) {
+    if (record.counts.available[i])
+      EXPECT_GE(record.counts.values[i], 0) << PerfCounts::names[i];
+    else
+      EXPECT_EQ(record.counts.values[i], 0) << PerfCounts::names[i];
+  }
+  if (record.counts.available[PerfCounts::instructions])
+    EXPECT_GT(record.counts.values[PerfCounts::instructions], 1 << 16);
+}
+
+TEST(PerfCountersTest, Evaluations) {
+  resetPerfReport();
+  NDArray<float, 2> a(3, 4), b(3, 4);
+  a = 1, b = 2;
+
+  a = a + b;
+  a = a + b;
+  a = a * b;
+
+  const auto report = perfReport();
+  EXPECT_EQ(report.size(), 2);
+  std::size_t calls = 0;
+  for (const auto& [expression, record] : report) {
+    EXPECT_NE(expression.find("nd::LazyFunction<"), std::string::npos);
+    calls += record.calls;
+  }
+  EXPECT_EQ(calls, 3);
+
+  resetPerfReport();
+  EXPECT_TRUE(perfReport().empty());
+}
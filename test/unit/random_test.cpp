@@ -0,0 +1,107 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the counter based random number generation.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace nd;
+
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+TEST(RandomTest, KnownAnswers) {
+  // Reference values of the Philox4x32-10 generator from the Random123 library.
+  EXPECT_EQ(RandomEngine(0, 0)(0), (RandomBlock{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+
+  const RandomEngine max_engine(~0ul, ~0ul);
+  EXPECT_EQ(max_engine(~0ul), (RandomBlock{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+
+  const RandomEngine pi_engine(0x299f31d0a4093822, 0x0370734413198a2e);
+  EXPECT_EQ(pi_engine(0x85a308d3243f6a88),
+            (RandomBlock{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+}
+
+TEST(RandomTest, ThreadIndependence) {
+  setNumThreads(1);
+  seed(7);
+  const auto a1 = rand<double>(300, 501);
+  const auto b1 = randn<float>(1001, 77);
+
+  setNumThreads(4);
+  seed(7);
+  const auto a4 = rand<double>(300, 501);
+  const auto b4 = randn<float>(1001, 77);
+
+  EXPECT_TRUE(equal(a1, a4));
+  EXPECT_TRUE(equal(b1, b4));
+  EXPECT_FALSE(std::equal(a1.begin(), a1.begin() + 100, a4.begin() + 100));
+}
+
+TEST(RandomTest, Moments) {
+  const std::size_t n = 1 << 20;
+  seed(1);
+  auto moments = [&](const auto& x) {
+    double sum = 0, sum2 = 0;
+    for (auto v : x) {
+      sum += v;
+      sum2 += v * v;
+    }
+    return std::make_pair(sum / n, sum2 / n - (sum / n) * (sum / n));
+  };
+
+  const auto uniform = rand<float>(n);
+  EXPECT_TRUE(std::all_of(uniform.begin(), uniform.end(), [](float x) { return x >= 0 && x < 1; }));
+  auto [mean, var] = moments(uniform);
+  EXPECT_NEAR(mean, 0.5, 3e-3);
+  EXPECT_NEAR(var, 1. / 12, 3e-3);
+
+  std::tie(mean, var) = moments(random(Normal<double>{2, 3}, n));
+  EXPECT_NEAR(mean, 2, 1e-2);
+  EXPECT_NEAR(var, 9, 5e-2);
+
+  std::tie(mean, var) = moments(random(Exponential<double>{4}, n));
+  EXPECT_NEAR(mean, 0.25, 1e-3);
+  EXPECT_NEAR(var, 1. / 16, 1e-3);
+}
+
+TEST(RandomTest, Streams) {
+  RandomEngine engine1(3, 0), engine2(3, 1), engine1_copy(3, 0);
+  NDArray<std::uint32_t, 1> a(100), b(100), c(100);
+  engine1.fill(a, RandomBits<std::uint32_t>());
+  engine2.fill(b, RandomBits<std::uint32_t>());
+  engine1_copy.fill(c, RandomBits<std::uint32_t>());
+  EXPECT_FALSE(equal(a, b));
+  EXPECT_TRUE(equal(a, c));
+
+  // Consecutive fills continue the stream.
+  engine1_copy.fill(c, RandomBits<std::uint32_t>());
+  EXPECT_FALSE(equal(a, c));
+  EXPECT_EQ(c(0), engine1(25)[0]);
+}
+
+TEST(RandomTest, View) {
+  NDArray<double, 2> x(10, 20);
+  x = -1;
+  RandomEngine(5).fill(x(range{2, 4}, range{5, 15}), Uniform<double>{10, 11});
+  for (std::size_t i = 0; i < 10; ++i)
+    for (std::size_t j = 0; j < 20; ++j) {
+      if (i >= 2 && i < 4 && j >= 5 && j < 15) {
+        EXPECT_LE(10, x(i, j));
+        EXPECT_GT(11, x(i, j));
+      }
+      else
+        EXPECT_EQ(-1, x(i, j));
+    }
+}
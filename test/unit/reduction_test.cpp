@@ -0,0 +1,60 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the reductions and their accumulation type.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace nd;
+
+TEST(ReductionTest, Sum) {
+  NDArray<int, 2> A{{1, 2, 3}, {4, 5, 6}};
+  EXPECT_EQ(sum(A), 21);
+  EXPECT_EQ(prod(A), 720);
+  EXPECT_EQ(sum(A(all, 1)), 7);                  // Strided.
+  EXPECT_EQ(sum(A * NDArray<int, 1>{1, 0, 1}), 14);  // Broadcasted.
+  EXPECT_EQ(sum(NDArray<int, 1>(0)), 0);
+}
+
+TEST(ReductionTest, Generic) {
+  NDArray<double, 1> A{3., -1., 7., 2.};
+  auto max = [](double a, double b) { return std::max(a, b); };
+  EXPECT_EQ(nd::reduce(max, -1e300, A), 7.);
+  EXPECT_EQ(nd::reduce(max, 10., A), 10.);
+}
+
+TEST(ReductionTest, AccumulationType) {
+  // Large enough to be reduced in parallel with partial results of every block.
+  const std::size_t n = 1 << 20;
+  NDArray<float, 1> A(n);
+  A = 0.1f;
+
+  const double exact = double(n) * double(0.1f);
+  const auto single = sum(A);
+  const auto accurate = sum<double>(A);
+  static_assert(std::is_same_v<decltype(single), const float>);
+  static_assert(std::is_same_v<decltype(accurate), const double>);
+  EXPECT_NEAR(accurate, exact, 1e-9 * exact);
+  EXPECT_NEAR(single, exact, 1e-4 * exact);
+
+  // The result does not depend on the number of threads.
+  const auto n_threads = getNumThreads();
+  setNumThreads(3);
+  EXPECT_EQ(sum(A * 3.f), sum(A * 3.f));
+  const float with_three = sum(A * 3.f);
+  setNumThreads(1);
+  EXPECT_EQ(sum(A * 3.f), with_three);
+  setNumThreads(n_threads);
+
+  // Scans can accumulate in a wider type too.
+  NDArray<std::int8_t, 1> small{100, 100, 100};
+  auto wide = cumsum<int>(small);
+  static_assert(std::is_same_v<decltype(wide), NDArray<int, 1>>);
+  EXPECT_EQ(wide[2], 300);
+}
@@ -0,0 +1,117 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the compile time rewriting of expressions.
+
+#define NDARRAY_FAST_MATH
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace nd;
+
+template <class E, class F>
+constexpr bool applies = false;
+template <class F, class... Args>
+constexpr bool applies<LazyFunction<F, Args...>, F> = true;
+
+TEST(RewriteTest, ConstantFolding) {
+  NDArray<double, 1> a(4);
+  a = 1.;
+
+  // Scalar only subtrees are evaluated immediately.
+  static_assert(std::is_same_v<decltype(nd::sqrt(4.)), double>);
+  EXPECT_EQ(nd::sqrt(4.), 2.);
+
+  // Scalar factors are reassociated and folded.
+  const auto scaled = 2. * (a * 3.) * 0.5;
+  static_assert(applies<std::decay_t<decltype(scaled)>, std::multiplies<>>);
+  EXPECT_EQ(std::get<1>(scaled.arguments()), 3.);
+  const auto shifted = (a + 1.) + 2.;
+  EXPECT_EQ(std::get<1>(shifted.arguments()), 3.);
+
+  NDArray<double, 1> b = scaled + shifted;
+  for (double x : b)
+    EXPECT_DOUBLE_EQ(x, 7.);
+}
+
+TEST(RewriteTest, Reciprocal) {
+  NDArray<double, 2> a(3, 5), b(3, 5), c(3, 5);
+  RandomEngine(0).fill(a, Uniform<double>{1, 2});
+  RandomEngine(1).fill(b, Uniform<double>{1, 2});
+  RandomEngine(2).fill(c, Uniform<double>{1, 2});
+
+  const auto divided = a / 4.;
+  static_assert(applies<std::decay_t<decltype(divided)>, std::multiplies<>>);
+  EXPECT_EQ(std::get<1>(divided.arguments()), 0.25);
+
+  // The division by 2 * b is rewritten as a division by b and a fused multiply add.
+  const auto update = c - a / (2. * b);
+  static_assert(applies<std::decay_t<decltype(update)>, details::NegativeMultiplyAdd>);
+  NDArray<double, 2> d = update;
+  for (std::size_t i = 0; i < d.size(); ++i)
+    EXPECT_NEAR(d[i], c[i] - a[i] / (2. * b[i]), 1e-15);
+
+  // Integer divisions are left untouched.
+  NDArray<int, 1> n(3);
+  n = 7;
+  static_assert(applies<std::decay_t<decltype(n / 2)>, std::divides<>>);
+  NDArray<int, 1> m = n / 2;
+  EXPECT_EQ(m[0], 3);
+}
+
+TEST(RewriteTest, MultiplyAdd) {
+  NDArray<float, 2> a(2, 3), b(2, 3), c(2, 3);
+  NDArray<float, 1> v(3);
+  RandomEngine(0).fill(a, Uniform<float>{-1, 1});
+  RandomEngine(1).fill(b, Uniform<float>{-1, 1});
+  RandomEngine(2).fill(c, Uniform<float>{-1, 1});
+  RandomEngine(3).fill(v, Uniform<float>{-1, 1});
+
+  static_assert(applies<std::decay_t<decltype(a * b + c)>, details::MultiplyAdd>);
+  static_assert(applies<std::decay_t<decltype(c + a * b)>, details::MultiplyAdd>);
+  static_assert(applies<std::decay_t<decltype(a * b - c)>, details::MultiplySubtract>);
+  static_assert(applies<std::decay_t<decltype(c - a * b)>, details::NegativeMultiplyAdd>);
+
+  NDArray<float, 2> r1 = a * b + c;
+  NDArray<float, 2> r2 = c - a * v;  // Broadcasted.
+  NDArray<float, 2> r3 = a * b(0, all) - 1.f;
+  for (std::size_t i = 0; i < 2; ++i)
+    for (std::size_t j = 0; j < 3; ++j) {
+      EXPECT_NEAR(r1(i, j), a(i, j) * b(i, j) + c(i, j), 1e-6);
+      EXPECT_NEAR(r2(i, j), c(i, j) - a(i, j) * v(j), 1e-6);
+      EXPECT_NEAR(r3(i, j), a(i, j) * b(0, j) - 1.f, 1e-6);
+    }
+
+  NDArray<int, 1> n(3);
+  n = 3;
+  NDArray<int, 1> m = 2 * n + 1;
+  EXPECT_EQ(m[2], 7);
+}
+
+TEST(RewriteTest, IntegerPower) {
+  NDArray<double, 1> a{0.5, -1.5, 3.};
+  NDArray<int, 1> n{2, -3, 4};
+
+  NDArray<double, 1> square = nd::pow<2>(a);
+  NDArray<double, 1> inverse_cube = nd::pow<-3>(a);
+  NDArray<int, 1> fifth = nd::pow<5>(n);
+  NDArray<double, 1> runtime_cube = nd::pow(a, 3);
+  NDArray<double, 1> runtime_root = nd::pow(a * a, 0.5);
+
+  for (std::size_t i = 0; i < 3; ++i) {
+    EXPECT_DOUBLE_EQ(square[i], a[i] * a[i]);
+    EXPECT_DOUBLE_EQ(inverse_cube[i], 1. / (a[i] * a[i] * a[i]));
+    EXPECT_EQ(fifth[i], n[i] * n[i] * n[i] * n[i] * n[i]);
+    EXPECT_DOUBLE_EQ(runtime_cube[i], std::pow(a[i], 3));
+    EXPECT_DOUBLE_EQ(runtime_root[i], std::abs(a[i]));
+  }
+
+  EXPECT_EQ(nd::pow<0>(7), 1);
+  EXPECT_EQ(nd::pow<10>(2), 1024);
+}
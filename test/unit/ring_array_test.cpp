@@ -0,0 +1,87 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Tests the circular buffer of frames.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+
+using namespace nd;
+
+TEST(RingArrayTest, Window) {
+  RingArray<int, 2> ring(4, {3});
+  EXPECT_EQ(ring.window(2).shape()[0], 0);
+
+  NDArray<int, 1> frame{0, 1, 2};
+  for (int i = 0; i < 3; ++i)
+    EXPECT_TRUE(ring.tryPush(frame + 10 * i));
+
+  auto window = ring.window(2);
+  EXPECT_EQ(window.shape(), (std::array<std::size_t, 2>{2, 3}));
+  EXPECT_EQ(window(0, 1), 11);
+  EXPECT_EQ(window(1, 2), 22);
+
+  // The frames of the window are not overwritten.
+  EXPECT_TRUE(ring.tryPush(frame + 30));
+  EXPECT_TRUE(ring.tryPush(frame + 40));
+  EXPECT_FALSE(ring.tryPush(frame + 50));
+  EXPECT_EQ(window(0, 0), 10);
+
+  // Wrapped around the end of the storage.
+  window = ring.window(3);
+  EXPECT_EQ(window(0, 0), 20);
+  EXPECT_EQ(window(2, 2), 42);
+  const auto [head, tail] = window.segments();
+  EXPECT_EQ(head.shape()[0], 2);
+  EXPECT_EQ(tail.shape()[0], 1);
+  EXPECT_EQ(head(1, 1), 31);
+  EXPECT_EQ(tail(0, 1), 41);
+
+  // The window is an operand of expressions and reductions.
+  NDArray<int, 2> twice = window * 2;
+  EXPECT_EQ(twice(1, 0), 60);
+  EXPECT_EQ(sum(window), 3 * (20 + 30 + 40) + 3 * 3);
+  NDArray<int, 1> mean = (window.frame(0) + window.frame(1) + window.frame(2)) / 3;
+  EXPECT_EQ(mean(2), 32);
+
+  RingArray<double, 1> scalars(3, {});
+  for (int i = 0; i < 3; ++i)
+    scalars.tryPush(double(i));
+  EXPECT_EQ(sum(scalars.window(3)), 3.);
+}
+
+TEST(RingArrayTest, Concurrent) {
+  constexpr int n_frames = 2000;
+  constexpr std::size_t length = 8;
+  RingArray<long, 2> ring(32, {16});
+
+  std::thread producer([&] {
+    NDArray<long, 1> frame(16);
+    for (long i = 0; i < n_frames;) {
+      frame = i;
+      if (ring.tryPush(frame))
+        ++i;
+    }
+  });
+
+  std::size_t checked = 0;
+  while (ring.pushed() < n_frames) {
+    const auto window = ring.window(length);
+    const std::size_t n = window.shape()[0];
+    if (n < 2)
+      continue;
+    // Frames are consecutive and complete.
+    const long first = window(0, 0);
+    for (std::size_t k = 0; k < n; ++k)
+      for (std::size_t j = 0; j < 16; ++j)
+        ASSERT_EQ(window(k, j), first + long(k));
+    ++checked;
+  }
+  producer.join();
+  EXPECT_GT(checked, 0);
+}
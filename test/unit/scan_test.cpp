@@ -0,0 +1,102 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests prefix scans along an axis.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+
+using namespace nd;
+
+// Serial reference implementation.
+template <class T, std::size_t dims, class Op>
+NDArray<T, dims> referenceScan(Op op, const NDArray<T, dims>& x, std::size_t axis) {
+  NDArray<T, dims> result = x;
+  broadcastShape(
+      [&](const auto& index) {
+        if (index[axis] == 0)
+          return;
+        auto previous = index;
+        --previous[axis];
+        result(index) = op(result(previous), result(index));
+      },
+      x.shape());
+  return result;
+}
+
+TEST(ScanTest, CumSum) {
+  NDArray<int, 1> a{1, 2, 3, 4};
+  auto s = cumsum(a);
+  EXPECT_EQ(s.shape(), a.shape());
+  EXPECT_EQ(s(0), 1);
+  EXPECT_EQ(s(3), 10);
+
+  NDArray<int, 3> A(3, 4, 5);
+  std::iota(A.begin(), A.end(), 0);
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    const auto expected = referenceScan(std::plus<>(), A, axis);
+    const auto result = cumsum(A, axis);
+    for (std::size_t i = 0; i < A.size(); ++i)
+      EXPECT_EQ(result[i], expected[i]);
+  }
+}
+
+TEST(ScanTest, LazyInput) {
+  NDArray<double, 3> A(4, 6, 3), B(4, 6, 3);
+  std::iota(A.begin(), A.end(), 1.);
+  B = 0.5;
+
+  // Product of two arrays, and a strided view.
+  const auto prod = cumprod(A(all, 1, all) * B(all, 2, all), 0);
+  NDArray<double, 2> expected = A(all, 1, all) * B(all, 2, all);
+  expected = referenceScan(std::multiplies<>(), expected, 0);
+  EXPECT_EQ(prod.shape(), expected.shape());
+  for (std::size_t i = 0; i < prod.size(); ++i)
+    EXPECT_DOUBLE_EQ(prod[i], expected[i]);
+
+  // Broadcasted expression.
+  const auto sum = cumsum(A(0, all, all) + A(0, 0, all), 1);
+  NDArray<double, 2> expected_sum = A(0, all, all) + A(0, 0, all);
+  expected_sum = referenceScan(std::plus<>(), expected_sum, 1);
+  for (std::size_t i = 0; i < sum.size(); ++i)
+    EXPECT_DOUBLE_EQ(sum[i], expected_sum[i]);
+}
+
+TEST(ScanTest, GenericOperation) {
+  NDArray<int, 2> A{{3, 1, 4}, {1, 5, 9}, {2, 6, 5}};
+  const auto running_max = scan([](int a, int b) { return std::max(a, b); }, A, 1);
+  EXPECT_EQ(running_max(0, 2), 4);
+  EXPECT_EQ(running_max(1, 1), 5);
+  EXPECT_EQ(running_max(2, 2), 6);
+}
+
+TEST(ScanTest, Parallel) {
+  setNumThreads(4);
+
+  // Long axis, split in blocks.
+  NDArray<long, 1> a(1000003);
+  std::iota(a.begin(), a.end(), 0);
+  const auto s = cumsum(a);
+  for (std::size_t i = 0; i < a.size(); i += 9973)
+    EXPECT_EQ(s[i], long(i) * (long(i) + 1) / 2);
+  EXPECT_EQ(s[a.size() - 1], long(a.size() - 1) * long(a.size()) / 2);
+
+  // Long axis with short rows, and many short fibres.
+  NDArray<long, 2> A(100000, 3);
+  std::iota(A.begin(), A.end(), 0);
+  for (std::size_t axis = 0; axis < 2; ++axis) {
+    const auto expected = referenceScan(std::plus<>(), A, axis);
+    const auto result = cumsum(A, axis);
+    for (std::size_t i = 0; i < A.size(); ++i)
+      ASSERT_EQ(result[i], expected[i]);
+  }
+
+  setNumThreads(1);
+}
@@ -0,0 +1,129 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the sparse matrices and their products.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <type_traits>
+
+using namespace nd;
+
+namespace {
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+CooMatrix<double> makeCoo() {
+  CooMatrix<double> coo(3, 4);
+  coo.insert(2, 1, 5.);
+  coo.insert(0, 3, 2.);
+  coo.insert(0, 0, 1.);
+  coo.insert(2, 1, 1.);  // Duplicate.
+  coo.insert(1, 2, -3.);
+  return coo;
+}
+
+const NDArray<double, 2> dense{{1, 0, 0, 2}, {0, 0, -3, 0}, {0, 6, 0, 0}};
+}  // namespace
+
+TEST(SparseTest, Construction) {
+  const auto coo = makeCoo();
+  EXPECT_EQ(coo.nnz(), 5);
+  EXPECT_EQ(coo({2, 1}), 6.);
+
+  const CsrMatrix<double> csr(coo);
+  EXPECT_EQ(csr.nnz(), 4);
+  EXPECT_EQ(csr.offsets(), (std::vector<std::size_t>{0, 2, 3, 4}));
+  EXPECT_EQ(csr.indices(), (std::vector<std::size_t>{0, 3, 2, 1}));
+  EXPECT_EQ(csr.values(), (std::vector<double>{1, 2, -3, 6}));
+  EXPECT_EQ(csr({0, 3}), 2.);
+  EXPECT_EQ(csr({1, 1}), 0.);
+  EXPECT_TRUE(equal(csr.toNDArray(), dense));
+
+  const CscMatrix<double> csc(coo);
+  EXPECT_EQ(csc.offsets(), (std::vector<std::size_t>{0, 1, 2, 3, 4}));
+  EXPECT_EQ(csc.indices(), (std::vector<std::size_t>{0, 2, 1, 0}));
+  EXPECT_TRUE(equal(csc.toNDArray(), dense));
+
+  const CscMatrix<double> converted(csr);
+  EXPECT_EQ(converted.offsets(), csc.offsets());
+  EXPECT_EQ(converted.indices(), csc.indices());
+  EXPECT_EQ(converted.values(), csc.values());
+  EXPECT_TRUE(equal(CsrMatrix<double>(converted).toNDArray(), dense));
+}
+
+TEST(SparseTest, Expressions) {
+  const CsrMatrix<double> s(makeCoo());
+  const NDArray<double, 2> d{{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}};
+
+  // Scaling and products with a dense array preserve the pattern.
+  auto scaled = 2. * (s * d) / 4.;
+  static_assert(sparse_object<decltype(scaled)>);
+  const CsrMatrix<double> result = scaled;
+  EXPECT_EQ(result.nnz(), s.nnz());
+  EXPECT_EQ(result.indices(), s.indices());
+  EXPECT_EQ(result.values(), (std::vector<double>{0.5, 4, -10.5, 30}));
+  EXPECT_EQ(scaled({2, 1}), 30.);
+  EXPECT_EQ(scaled({2, 2}), 0.);
+
+  // Broadcast of a row.
+  const NDArray<double, 1> row{1, 2, 3, 4};
+  const CscMatrix<double> by_row = row * s;
+  const NDArray<double, 2> expected{{1, 0, 0, 8}, {0, 0, -9, 0}, {0, 12, 0, 0}};
+  EXPECT_TRUE(equal(by_row.toNDArray(), expected));
+
+  // In place update of the values.
+  CsrMatrix<double> t = s;
+  t = t * 3.;
+  EXPECT_EQ(t.values(), (std::vector<double>{3, 6, -9, 18}));
+
+  // Other operations are dense.
+  const NDArray<double, 2> sum = s + d;
+  EXPECT_TRUE(equal(sum, NDArray<double, 2>(dense + d)));
+}
+
+TEST(SparseTest, Products) {
+  CooMatrix<float> coo(300, 200);
+  for (std::size_t i = 0; i < 300; ++i)
+    for (std::size_t j = (i * 7) % 13; j < 200; j += 13)
+      coo.insert(i, j, float(i) - 2 * float(j));
+  const CsrMatrix<float> csr(coo);
+  const CscMatrix<float> csc(coo);
+  const NDArray<float, 2> a = csr.toNDArray();
+
+  NDArray<float, 1> x(200);
+  for (std::size_t j = 0; j < 200; ++j)
+    x(j) = float(j % 5) - 2;
+  NDArray<float, 2> m(200, 3);
+  for (std::size_t j = 0; j < 200; ++j)
+    for (std::size_t c = 0; c < 3; ++c)
+      m(j, c) = float((j + c) % 4);
+
+  NDArray<float, 1> y_ref(300);
+  NDArray<float, 2> z_ref(300, 3);
+  for (std::size_t i = 0; i < 300; ++i) {
+    y_ref(i) = 0;
+    for (std::size_t c = 0; c < 3; ++c)
+      z_ref(i, c) = 0;
+    for (std::size_t j = 0; j < 200; ++j) {
+      y_ref(i) += a(i, j) * x(j);
+      for (std::size_t c = 0; c < 3; ++c)
+        z_ref(i, c) += a(i, j) * m(j, c);
+    }
+  }
+
+  // The values are integers, exactly representable in any summation order.
+  EXPECT_TRUE(equal(matmul(csr, x), y_ref));
+  EXPECT_TRUE(equal(matmul(csc, x), y_ref));
+  EXPECT_TRUE(equal(matmul(csr, m), z_ref));
+  EXPECT_TRUE(equal(matmul(csc, m), z_ref));
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the instrumentation of allocations and temporaries.
+
+#define NDARRAY_STATS
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace nd;
+
+TEST(StatsTest, Allocations) {
+  resetStats();
+  const auto start = stats<float>();
+  {
+    NDArray<float, 2> a(10, 20);
+    EXPECT_EQ(stats().allocations, 1);
+    EXPECT_EQ(stats().bytes_allocated, 800);
+    EXPECT_EQ(stats<float>().live_bytes - start.live_bytes, 800);
+
+    NDArray<float, 2> b = a;
+    NDArray<float, 2> c(a(all, range{0, 10}));
+    EXPECT_EQ(stats().allocations, 3);
+    EXPECT_EQ(stats<float>().allocations - start.allocations, 3);
+    EXPECT_EQ(stats<double>().allocations, 0);
+  }
+  EXPECT_EQ(stats<float>().live_bytes, start.live_bytes);
+  EXPECT_EQ(stats().peak_live_bytes, 800 + 800 + 400);
+
+  NDArray<bool, 1> mask(16);
+  EXPECT_EQ(stats<bool>().bytes_allocated, 16);
+}
+
+TEST(StatsTest, HotLoop) {
+  NDArray<double, 2> a(100, 100), b(100, 100);
+  a = 1;
+  b = 2;
+
+  ScopedStats scope;
+  for (int i = 0; i < 10; ++i) {
+    a = a + 2. * b;
+    a(all, 0) = b(all, 1);
+  }
+  EXPECT_EQ(scope.get().allocations, 0);
+  EXPECT_EQ(scope.get().temporaries, 0);
+}
+
+TEST(StatsTest, Temporaries) {
+  NDArray<int, 2> a(4, 5);
+  a = 1;
+
+  ScopedStats scope;
+  // Non contiguous expressions are evaluated into a temporary.
+  a = a(all, range{0, 5}) + 1;
+  EXPECT_EQ(scope.get().temporaries, 1);
+  EXPECT_EQ(scope.get().allocations, 1);
+  EXPECT_EQ(scope.get().peak_live_bytes, scope.get().live_bytes + 4 * 5 * sizeof(int));
+
+  // Aliased gathers.
+  NDArray<int, 1> idx{4, 3, 2, 1, 0};
+  a = a(all, idx);
+  EXPECT_EQ(stats<int>().temporaries, 2);
+}
@@ -0,0 +1,124 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the application of stencils with different boundary conditions.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+using namespace nd;
+
+using Laplacian = StencilPattern<Offset<2>{0, 0}, Offset<2>{-1, 0}, Offset<2>{1, 0},
+                                 Offset<2>{0, -1}, Offset<2>{0, 1}>;
+
+struct Laplace {
+  double operator()(double c, double n, double s, double w, double e) const {
+    return n + s + w + e - 4 * c;
+  }
+};
+
+// Serial reference implementation of a single sweep.
+NDArray<double, 2> referenceSweep(const NDArray<double, 2>& in, Boundary boundary,
+                                  double value) {
+  const long n = in.shape()[0], m = in.shape()[1];
+  NDArray<double, 2> out = in;
+  auto read = [&](long i, long j) {
+    if (boundary == Boundary::periodic)
+      return in((i + n) % n, (j + m) % m);
+    if (i < 0 || i >= n || j < 0 || j >= m)
+      return value;
+    return in(i, j);
+  };
+  for (long i = 0; i < n; ++i)
+    for (long j = 0; j < m; ++j) {
+      if (boundary == Boundary::skip && (i == 0 || j == 0 || i == n - 1 || j == m - 1))
+        continue;
+      out(i, j) = Laplace()(read(i, j), read(i - 1, j), read(i + 1, j), read(i, j - 1),
+                            read(i, j + 1));
+    }
+  return out;
+}
+
+NDArray<double, 2> makeInput(std::size_t n, std::size_t m) {
+  NDArray<double, 2> in(n, m);
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 0; j < m; ++j)
+      in(i, j) = double((i * 7 + j * 13) % 17) - 8;
+  return in;
+}
+
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+TEST(StencilTest, Pattern) {
+  using P = StencilPattern<Offset<2>{-2, 0}, Offset<2>{0, 1}>;
+  EXPECT_EQ(P::size, 2);
+  EXPECT_EQ(P::lower, (Offset<2>{2, 0}));
+  EXPECT_EQ(P::upper, (Offset<2>{0, 1}));
+}
+
+TEST(StencilTest, BoundaryConditions) {
+  setNumThreads(4);
+  const auto in = makeInput(70, 1100);
+
+  for (auto boundary : {Boundary::skip, Boundary::periodic, Boundary::constant}) {
+    NDArray<double, 2> out = in;
+    stencil<Laplacian>(Laplace(), in, out, boundary, 2.);
+    EXPECT_TRUE(equal(out, referenceSweep(in, boundary, 2.)));
+  }
+}
+
+TEST(StencilTest, View) {
+  const auto in = makeInput(20, 30);
+  NDArray<double, 2> out(20, 30);
+  out = 0;
+
+  // Apply to the first half of the columns.
+  auto in_view = in(all, range{0, 15});
+  auto out_view = out(all, range{0, 15});
+  stencil<Laplacian>(Laplace(), in_view, out_view, Boundary::constant);
+
+  NDArray<double, 2> in_copy(20, 15);
+  for (std::size_t i = 0; i < 20; ++i)
+    for (std::size_t j = 0; j < 15; ++j)
+      in_copy(i, j) = in(i, j);
+  const auto expected = referenceSweep(in_copy, Boundary::constant, 0.);
+  for (std::size_t i = 0; i < 20; ++i)
+    for (std::size_t j = 0; j < 15; ++j) {
+      EXPECT_EQ(out(i, j), expected(i, j));
+      EXPECT_EQ(out(i, j + 15), 0);
+    }
+}
+
+TEST(StencilTest, TemporalBlocking) {
+  setNumThreads(4);
+  const auto in = makeInput(90, 600);
+
+  for (auto boundary : {Boundary::skip, Boundary::periodic, Boundary::constant}) {
+    NDArray<double, 2> out = in;
+    stencil<Laplacian>(Laplace(), in, out, boundary, 1., 3);
+
+    auto expected = in;
+    for (int sweep = 0; sweep < 3; ++sweep)
+      expected = referenceSweep(expected, boundary, 1.);
+    EXPECT_TRUE(equal(out, expected));
+  }
+}
+
+TEST(StencilTest, OneDimensional) {
+  NDArray<int, 1> in{1, 2, 3, 4, 5};
+  NDArray<int, 1> out(5);
+  out = 0;
+  using Diff = StencilPattern<Offset<1>{-1}, Offset<1>{1}>;
+  stencil<Diff>([](int l, int r) { return r - l; }, in, out, Boundary::periodic);
+  EXPECT_TRUE(equal(out, NDArray<int, 1>{2 - 5, 2, 2, 2, 1 - 4}));
+}
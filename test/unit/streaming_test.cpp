@@ -0,0 +1,107 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the out of core evaluation of expressions.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <filesystem>
+
+using namespace nd;
+
+namespace {
+std::filesystem::path temporary(const std::string& name) {
+  return std::filesystem::temp_directory_path() / ("ndarray_streaming_test_" + name);
+}
+
+// In memory source recording the largest slab read.
+struct CountingSource {
+  using value_type = float;
+  constexpr static std::size_t dimensions = 2;
+
+  const auto& shape() const {
+    return array.shape();
+  }
+  void readRows(std::size_t begin, std::size_t end, NDArray<float, 2>& slab) const {
+    max_rows = std::max(max_rows, end - begin);
+    const std::size_t row = array.shape()[1];
+    slab.reshape(end - begin, row);
+    std::copy(array.begin() + begin * row, array.begin() + end * row, slab.begin());
+  }
+
+  NDArray<float, 2> array;
+  mutable std::size_t max_rows = 0;
+};
+
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+}  // namespace
+
+TEST(StreamingTest, FileArray) {
+  NDArray<int, 2> a{{1, 2, 3}, {4, 5, 6}};
+  const auto file = FileArray<int, 2>::create(temporary("file"), a);
+  EXPECT_EQ(file.rowSize(), 3);
+
+  NDArray<int, 2> slab;
+  file.readRows(1, 2, slab);
+  EXPECT_EQ(slab.shape(), (std::array<std::size_t, 2>{1, 3}));
+  EXPECT_EQ(slab(0, 2), 6);
+
+  slab = 0;
+  file.writeRows(0, slab);
+  const FileArray<int, 2> reopened(file.path(), {2, 3});
+  EXPECT_EQ(reopened.load()(0, 1), 0);
+  EXPECT_EQ(reopened.load()(1, 1), 5);
+
+  EXPECT_THROW((FileArray<int, 2>(file.path(), {3, 3})), std::runtime_error);
+  std::filesystem::remove(file.path());
+}
+
+TEST(StreamingTest, Evaluation) {
+  NDArray<double, 3> a(37, 4, 5), b(37, 4, 5);
+  int i = 0;
+  for (auto& x : a)
+    x = ++i;
+  for (auto& x : b)
+    x = 1 + (++i % 7);
+
+  const auto file_a = FileArray<double, 3>::create(temporary("a"), a);
+  const auto file_b = FileArray<double, 3>::create(temporary("b"), b);
+  const auto file_c = FileArray<double, 3>::create(temporary("c"), a.shape());
+
+  const NDArray<double, 3> expected = a - a / (2 * b);
+  // Slabs of 3 rows, not dividing the leading extent.
+  const std::size_t budget = 3 * 2 * 3 * 20 * sizeof(double);
+  stream([](const auto& a, const auto& b) { return a - a / (2 * b); }, file_c, budget, file_a,
+         file_b);
+  EXPECT_TRUE(equal(file_c.load(), expected));
+
+  // A slab holds at least one row.
+  stream([](const auto& a) { return a * 2.; }, file_c, 1, file_a);
+  EXPECT_TRUE(equal(file_c.load(), makeTensor(a * 2.)));
+
+  for (const auto& file : {file_a, file_b, file_c})
+    std::filesystem::remove(file.path());
+}
+
+TEST(StreamingTest, BoundedMemory) {
+  CountingSource source{NDArray<float, 2>(100, 10)};
+  source.array = 1.f;
+  const auto out = FileArray<float, 2>::create(temporary("out"), source.shape());
+
+  // Input and output, double buffered.
+  const std::size_t row_bytes = 10 * sizeof(float);
+  stream([](const auto& x) { return x + 1.f; }, out, 8 * 4 * row_bytes, source);
+  EXPECT_EQ(source.max_rows, 8);
+  EXPECT_TRUE(equal(out.load(), makeTensor(source.array + 1.f)));
+  std::filesystem::remove(out.path());
+}
@@ -0,0 +1,100 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the tiled storage layouts.
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <mutex>
+
+using namespace nd;
+
+namespace {
+template <class T, std::size_t dims>
+bool equal(const NDArray<T, dims>& a, const NDArray<T, dims>& b) {
+  return a.shape() == b.shape() && std::equal(a.begin(), a.end(), b.begin());
+}
+}  // namespace
+
+TEST(TiledArrayTest, Blocked) {
+  TiledArray<int, 2, 4> a(6, 5);
+  EXPECT_EQ(a.tiles(), (std::array<std::size_t, 2>{2, 2}));
+
+  a(0, 3) = 1;
+  a(1, 0) = 2;
+  a(4, 4) = 3;
+  // Row major inside the first tile.
+  EXPECT_EQ(a.data()[3], 1);
+  EXPECT_EQ(a.data()[4], 2);
+  // Last tile, after the three previous ones.
+  EXPECT_EQ(a.data()[3 * 16], 3);
+
+  auto tile = a.tileView({1, 1});
+  EXPECT_EQ(tile.shape(), (std::array<std::size_t, 2>{2, 1}));
+  EXPECT_EQ(tile(0, 0), 3);
+  tile(1, 0) = 4;
+  EXPECT_EQ(a(5, 4), 4);
+}
+
+TEST(TiledArrayTest, Morton) {
+  TiledArray<int, 2, 4, TileLayout::morton> a(4, 4);
+  a(0, 1) = 1;
+  a(1, 0) = 2;
+  a(1, 1) = 3;
+  a(0, 2) = 4;
+  a(3, 3) = 5;
+  EXPECT_EQ(a.data()[1], 1);
+  EXPECT_EQ(a.data()[2], 2);
+  EXPECT_EQ(a.data()[3], 3);
+  EXPECT_EQ(a.data()[4], 4);
+  EXPECT_EQ(a.data()[15], 5);
+}
+
+TEST(TiledArrayTest, Conversion) {
+  NDArray<float, 3> a(9, 10, 11);
+  int i = 0;
+  for (auto& x : a)
+    x = i++;
+
+  const TiledArray<float, 3> tiled(a);
+  EXPECT_EQ(tiled(8, 9, 10), a(8, 9, 10));
+  EXPECT_TRUE(equal(tiled.toNDArray(), a));
+
+  const TiledArray<float, 3, 2, TileLayout::morton> morton(a);
+  EXPECT_TRUE(equal(morton.toNDArray(), a));
+
+  // Every element is visited once.
+  std::size_t visited = 0;
+  std::mutex mutex;
+  morton.forEach([&](const auto& idx, float x) {
+    EXPECT_EQ(x, a(idx));
+    std::unique_lock<std::mutex> lock(mutex);
+    ++visited;
+  });
+  EXPECT_EQ(visited, a.size());
+}
+
+TEST(TiledArrayTest, Expressions) {
+  NDArray<double, 2> a(13, 7), b(13, 7);
+  a = 3., b = 2.;
+  const TiledArray<double, 2> ta(a), tb(b);
+
+  // Tiled arrays are operands of lazy expressions, and are evaluated tile by tile.
+  TiledArray<double, 2> tc(ta - ta / (2. * tb));
+  EXPECT_EQ(tc(12, 6), 3. - 3. / 4.);
+
+  NDArray<double, 1> row(7);
+  row = 1.;
+  tc = tb * row;
+  EXPECT_EQ(tc(5, 5), 2.);
+
+  NDArray<double, 2> c = a + tb;
+  EXPECT_EQ(c(12, 6), 5.);
+}
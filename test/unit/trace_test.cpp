@@ -0,0 +1,68 @@
+// Copyright (C) 2020 Giovanni Balduzzi
+// All rights reserved.
+//
+// See LICENSE for terms of usage.
+//
+// Author: Giovanni Balduzzi (gbalduzz@itp.phys.ethz.ch)
+//
+// Tests the tracing of evaluations.
+
+#define NDARRAY_TRACE
+
+#include "ndarray/nd_array.hpp"
+
+#include "gtest/gtest.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace nd;
+
+std::string readFile(const std::string& filename) {
+  std::ifstream in(filename);
+  std::stringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+std::size_t count(const std::string& text, const std::string& pattern) {
+  std::size_t n = 0;
+  for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+    ++n;
+  return n;
+}
+
+TEST(TraceTest, Evaluations) {
+  const std::string filename = std::filesystem::temp_directory_path() / "ndarray_trace.json";
+  NDArray<float, 2> a(3, 4), b(3, 4);
+  NDArray<float, 1> c(4);
+  a = 1, b = 2, c = 3;
+
+  a = a + b;  // Not traced.
+
+  startTracing();
+  a = a + b;
+  NDArray<float, 2> d = a * c;  // Nested with the broadcasted NDView::operator=.
+  a(all, 0) = b(all, 1) * 2.f;
+  broadcast([](float& x, float y) { x += y; }, a, b);
+  stopTracing(filename);
+
+  a = a + b;  // Not traced.
+
+  const std::string trace = readFile(filename);
+  EXPECT_EQ(trace.substr(0, 15), "{\"traceEvents\":");
+  EXPECT_EQ(count(trace, "\"ph\":\"X\""), 5);
+  EXPECT_EQ(count(trace, "\"name\":\"NDArray::operator=\""), 1);
+  EXPECT_EQ(count(trace, "\"name\":\"NDArray::NDArray\""), 1);
+  EXPECT_EQ(count(trace, "\"name\":\"NDView::operator=\""), 2);
+  EXPECT_EQ(count(trace, "\"name\":\"broadcast\""), 1);
+  EXPECT_EQ(count(trace, "\"path\":\"contiguous\""), 1);
+  EXPECT_EQ(count(trace, "\"path\":\"broadcast\""), 2);
+  EXPECT_EQ(count(trace, "\"path\":\"strided\""), 2);
+  EXPECT_EQ(count(trace, "\"shape\":\"(3, 4)\""), 4);
+  EXPECT_EQ(count(trace, "\"elements\":12"), 4);
+  EXPECT_NE(trace.find("nd::LazyFunction<std::plus"), std::string::npos);
+
+  std::filesystem::remove(filename);
+}